@@ -0,0 +1,176 @@
+#include "bench.hpp"
+#include "automaton.hpp"
+#include "generators.hpp"
+#include <chrono>
+#include <random>
+#include <string_view>
+
+BENCH(dfa_accepts) {
+    // binary numbers divisible by 3
+    auto dfa = DFA::fromRegex("(0|(1(01*0)*1))*");
+    CompiledDFA compiled{dfa};
+    auto input = randomBinary(state.scaled(10000000), 1);
+
+    state.measure("DFA::accepts/" + std::to_string(input.size()), input.size(), [&] {
+        doNotOptimize(dfa.accepts(input));
+    });
+
+    state.measure("CompiledDFA::accepts/" + std::to_string(input.size()), input.size(), [&] {
+        doNotOptimize(compiled.accepts(input));
+    });
+}
+
+BENCH(dfa_match_batch) {
+    // IRIs of one namespace, a tenth of them outside it
+    auto dfa = DFA::fromRegex("http://example.org/(a|b|c|d|e|f|g|h|i|j|k|l|m|n|o|p|q|r|s|t|u|v|w|x|y|z|/|_)*");
+    CompiledDFA compiled{dfa};
+
+    std::mt19937 rng(5);
+    std::vector<std::string> iris(state.scaled(1000000));
+    size_t bytes = 0;
+    for (auto &iri : iris) {
+        iri = rng() % 10 ? "http://example.org/" : "http://example.com/";
+        for (int len = 10 + rng() % 100; len > 0; --len) {
+            iri.push_back("abcdefghijklmnopqrstuvwxyz/_"[rng() % 28]);
+        }
+        bytes += iri.size();
+    }
+    std::vector<std::string_view> views(iris.begin(), iris.end());
+    std::vector<char> res(iris.size());
+
+    // reports GB/s next to the per-byte timing
+    auto throughput = [&](const std::string &label, auto &&fn) {
+        double ns = 0;
+        state.measure(label, bytes, [&] {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        });
+        state.metric(label, "GB/s", bytes / ns);
+    };
+
+    auto label = "/" + std::to_string(iris.size());
+    throughput("DFA::accepts" + label, [&] {
+        for (size_t i = 0; i < iris.size(); ++i) {
+            res[i] = dfa.accepts(iris[i]);
+        }
+    });
+    throughput("CompiledDFA::accepts" + label, [&] {
+        for (size_t i = 0; i < iris.size(); ++i) {
+            res[i] = compiled.accepts(iris[i]);
+        }
+    });
+    throughput("CompiledDFA::accepts/batch" + label, [&] {
+        compiled.accepts(views.data(), views.size(), res.data());
+    });
+    doNotOptimize(res.data());
+}
+
+BENCH(dfa_minimize) {
+    for (int n : { 1000, 10000, 100000 }) {
+        n = state.scaled(n);
+        auto dfa = randomDFA(n, 8, n);
+        state.measure("DFA::minimize/random/" + std::to_string(n), n, [&] {
+            auto copy = dfa;
+            copy.minimize();
+            doNotOptimize(copy.size());
+        });
+    }
+}
+
+BENCH(nfa_determinize) {
+    for (int words : { 100, 300, 1000 }) {
+        words = state.scaled(words);
+        auto nfa = NFA::fromRegex(randomAlternation(words, words));
+        state.measure("NFA::determinize/alternation/" + std::to_string(words), 1, [&] {
+            doNotOptimize(nfa.determinize().size());
+        });
+    }
+}
+
+BENCH(regex_compile) {
+    // random expressions using every operator, over a small alphabet
+    for (int depth : { 8, 12, 16 }) {
+        std::vector<std::string> regexes;
+        for (unsigned seed = 0; seed < 20; ++seed) {
+            regexes.push_back(randomRegex(depth, "abcd", seed));
+        }
+
+        state.measure("DFA::fromRegex/random/depth=" + std::to_string(depth), regexes.size(), [&] {
+            size_t states = 0;
+            for (auto &regex : regexes) {
+                states += DFA::fromRegex(regex).size();
+            }
+            doNotOptimize(states);
+        });
+    }
+
+    // predicate alternations as generated for path queries
+    for (int names : { 1000, 10000 }) {
+        names = state.scaled(names);
+        std::string regex = "(";
+        for (int i = 0; i < names; ++i) {
+            regex += (i ? "|<" : "<") + std::to_string(i) + ">";
+        }
+        regex += ")*";
+
+        state.measure("DFA::fromRegex/names/" + std::to_string(names), 1, [&] {
+            doNotOptimize(DFA::fromRegex(regex, [](const std::string &name) {
+                return std::stoi(name);
+            }).size());
+        });
+    }
+}
+
+BENCH(dfa_cache) {
+    // a workload repeating a few hundred path expressions
+    std::vector<std::string> regexes;
+    for (unsigned seed = 0; seed < 300; ++seed) {
+        regexes.push_back(randomRegex(8, "abcd", seed));
+    }
+    std::vector<size_t> queries(state.scaled(20000));
+    std::mt19937 rng(3);
+    for (auto &q : queries) {
+        q = rng() % regexes.size();
+    }
+
+    state.measure("DFA::fromRegex/uncached/" + std::to_string(queries.size()), queries.size(), [&] {
+        size_t states = 0;
+        for (auto q : queries) {
+            states += DFA::fromRegex(regexes[q]).size();
+        }
+        doNotOptimize(states);
+    });
+
+    for (size_t capacity : { 64, 1024 }) {
+        DFACache cache(capacity);
+        state.measure("DFA::fromRegex/cached/capacity=" + std::to_string(capacity), queries.size(), [&] {
+            size_t states = 0;
+            for (auto q : queries) {
+                states += DFA::fromRegex(regexes[q], cache)->size();
+            }
+            doNotOptimize(states);
+        });
+        auto stats = cache.stats();
+        state.metric("DFACache/hit-rate/capacity=" + std::to_string(capacity), "%",
+                     100.0 * stats.hits / (stats.hits + stats.misses));
+    }
+}
+
+BENCH(dfa_intersect) {
+    // two ~2000 state automata for word lists, most pairs are unreachable
+    int words = state.scaled(500);
+    auto a = DFA::fromRegex(randomAlternation(words, 1));
+    auto b = DFA::fromRegex(randomAlternation(words, 2));
+    auto label = std::to_string(a.size()) + "x" + std::to_string(b.size());
+
+    state.measure("DFA::intersect/words/" + label, 1, [&] {
+        auto res = a;
+        res.intersect(b);
+        doNotOptimize(res.size());
+    });
+
+    state.measure("DFA::intersects/words/" + label, 1, [&] {
+        doNotOptimize(a.intersects(b));
+    });
+}
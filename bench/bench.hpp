@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class BenchState {
+public:
+    explicit BenchState(double scale) : scale(scale) {}
+
+    // problem size adjusted by the --scale command line option
+    size_t scaled(size_t n) const {
+        return std::max<size_t>(1, n * scale);
+    }
+
+    // times fn, which performs ops operations, and reports ns and heap
+    // allocations per op and the peak resident set size while it ran
+    template <typename F>
+    void measure(const std::string &label, size_t ops, F &&fn) {
+        resetPeakMemory();
+        size_t allocs = allocationCount();
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        allocs = allocationCount() - allocs;
+        report(label, ops, std::chrono::duration<double, std::nano>(end - start).count(), allocs, peakMemory());
+    }
+
+    // reports a value that is not a timing, such as a memory footprint
+    void metric(const std::string &label, const std::string &unit, double value);
+
+    // number of operator new calls since program start
+    static size_t allocationCount();
+    // peak resident set size in KiB, since the last reset where the
+    // kernel supports resetting it and since program start otherwise
+    static size_t peakMemory();
+    static void resetPeakMemory();
+
+    enum class Format {
+        Text,
+        // one JSON object per result and line
+        Json
+    };
+
+    Format format = Format::Text;
+
+private:
+    void report(const std::string &label, size_t ops, double ns, size_t allocs, size_t peakKiB);
+
+    double scale;
+};
+
+struct Benchmark {
+    const char *name;
+    void (*run)(BenchState &state);
+};
+
+std::vector<Benchmark> &benchmarks();
+
+struct BenchRegistrar {
+    BenchRegistrar(const char *name, void (*run)(BenchState &state)) {
+        benchmarks().push_back({ name, run });
+    }
+};
+
+#define BENCH(name) \
+    static void bench_##name(BenchState &state); \
+    static BenchRegistrar registrar_##name{#name, bench_##name}; \
+    static void bench_##name(BenchState &state)
+
+// prevents the compiler from optimizing away a computed value
+template <typename T>
+void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
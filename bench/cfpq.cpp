@@ -0,0 +1,48 @@
+#include "bench.hpp"
+#include "cfpq.hpp"
+#include <random>
+
+namespace {
+
+// random class hierarchy, every class has a random earlier superclass
+// and extra cross edges with another predicate
+DictionaryGraph randomHierarchy(size_t classes) {
+    std::mt19937 rng(42);
+    DictionaryGraph graph;
+    for (size_t i = 1; i < classes; ++i) {
+        graph.addTriple({ "ex:c" + std::to_string(i), "ex:subClassOf", "ex:c" + std::to_string(rng() % i) });
+        graph.addTriple({ "ex:c" + std::to_string(i), "ex:related", "ex:c" + std::to_string(rng() % classes) });
+    }
+    return graph;
+}
+
+} // namespace
+
+BENCH(cfpq) {
+    auto grammar = Grammar::fromString(
+        "S -> <ex:subClassOf> S <^ex:subClassOf> | <ex:subClassOf> <ex:related>* <^ex:subClassOf>"
+    );
+
+    for (size_t n : { state.scaled(10000), state.scaled(1000000) }) {
+        auto graph = randomHierarchy(n);
+        CsrGraph csr(graph);
+        ContextFreeQuery query(csr, graph.terms().view(), grammar);
+        auto label = std::to_string(csr.edgeCount()) + "-edges";
+
+        state.measure("cfpq/single/" + label, 10, [&] {
+            size_t pairs = 0;
+            for (int i = 0; i < 10; ++i) {
+                auto start = graph.terms().find("ex:c" + std::to_string(n - 1 - i));
+                pairs += query.evaluate(start).size();
+            }
+            doNotOptimize(pairs);
+        });
+    }
+
+    auto graph = randomHierarchy(state.scaled(2000));
+    CsrGraph csr(graph);
+    ContextFreeQuery query(csr, graph.terms().view(), grammar);
+    state.measure("cfpq/all/" + std::to_string(csr.edgeCount()) + "-edges", 1, [&] {
+        doNotOptimize(query.evaluate().size());
+    });
+}
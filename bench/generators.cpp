@@ -0,0 +1,156 @@
+#include "generators.hpp"
+#include <functional>
+#include <random>
+
+std::string randomBinary(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string s(n, '0');
+    for (auto &c : s) {
+        c = '0' + (rng() & 1);
+    }
+    return s;
+}
+
+std::string randomRegex(int depth, const std::string &symbols, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::function<std::string(int)> gen = [&](int depth) -> std::string {
+        switch (depth > 0 ? rng() % 4 : 0) {
+            case 0:
+                return std::string(1, symbols[rng() % symbols.size()]);
+            case 1:
+                return gen(depth - 1) + gen(depth - 1);
+            case 2:
+                return "(" + gen(depth - 1) + "|" + gen(depth - 1) + ")";
+            default:
+                return "(" + gen(depth - 1) + ")*";
+        }
+    };
+    return gen(depth);
+}
+
+std::string randomAlternation(int words, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string regex = "(";
+    for (int i = 0; i < words; ++i) {
+        if (i > 0) regex += '|';
+        for (int len = 3 + rng() % 4; len > 0; --len) {
+            regex += char('a' + rng() % 26);
+        }
+    }
+    return regex + ")*";
+}
+
+DFA randomDFA(int states, int symbols, unsigned seed) {
+    std::mt19937 rng(seed);
+    DFA dfa;
+    for (int i = 0; i < states; ++i) {
+        dfa.addState(rng() % 4 == 0);
+    }
+    for (int i = 0; i < states; ++i) {
+        for (int ch = 0; ch < symbols; ++ch) {
+            if (rng() % 8 != 0) {
+                dfa.addTransition(i, 'a' + ch, rng() % states);
+            }
+        }
+    }
+    return dfa;
+}
+
+std::vector<Triple> randomTriples(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> node(0, n / 4);
+    std::uniform_int_distribution<size_t> pred(0, 63);
+
+    std::vector<Triple> res;
+    res.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (i > 0 && i % 10 == 0) {
+            res.push_back(res[rng() % i]);
+            continue;
+        }
+        res.push_back(Triple {
+            "ex:n" + std::to_string(node(rng)),
+            "ex:p" + std::to_string(pred(rng)),
+            "ex:n" + std::to_string(node(rng))
+        });
+    }
+    return res;
+}
+
+DictionaryGraph randomGraph(size_t nodes, size_t degree, unsigned seed) {
+    std::mt19937 rng(seed);
+    DictionaryGraph graph;
+    for (size_t i = 0; i < nodes * degree; ++i) {
+        graph.addTriple({
+            "ex:n" + std::to_string(rng() % nodes),
+            "ex:p" + std::to_string(rng() % 8),
+            "ex:n" + std::to_string(rng() % nodes)
+        });
+    }
+    return graph;
+}
+
+std::vector<Statement> scaledSample(size_t copies) {
+    const Statement sample[] = {
+        { "ex:Picasso", "http://www.w3.org/1999/02/22-rdf-syntax-ns#type", "ex:Artist" },
+        { "ex:Picasso", "foaf:firstName", "Pablo" },
+        { "ex:Picasso", "foaf:surname", "Picasso" },
+        { "ex:Picasso", "ex:creatorOf", "ex:guernica" },
+        { "ex:Picasso", "ex:homeAddress", "node1" },
+        { "node1", "ex:street", "31 Art Gallery" },
+        { "node1", "ex:city", "Madrid" },
+        { "node1", "ex:country", "Spain" },
+        { "ex:guernica", "http://www.w3.org/1999/02/22-rdf-syntax-ns#type", "ex:Painting" },
+        { "ex:guernica", "rdfs:label", "Guernica" },
+        { "ex:guernica", "ex:technique", "oil on canvas" },
+        { "ex:VanGogh", "http://www.w3.org/1999/02/22-rdf-syntax-ns#type", "ex:Artist" },
+        { "ex:VanGogh", "foaf:firstName", "Vincent" },
+        { "ex:VanGogh", "foaf:surname", "van Gogh" },
+        { "ex:VanGogh", "ex:creatorOf", "ex:starryNight" },
+        { "ex:starryNight", "http://www.w3.org/1999/02/22-rdf-syntax-ns#type", "ex:Painting" },
+        { "ex:starryNight", "ex:technique", "oil on canvas" },
+        { "ex:starryNight", "rdfs:label", "Starry Night" },
+    };
+
+    std::vector<Statement> res;
+    for (size_t i = 0; i < copies; ++i) {
+        auto suffix = std::to_string(i);
+        for (auto &st : sample) {
+            bool literal = st.object.find(':') == std::string::npos && st.object != "node1";
+            res.push_back({
+                st.subject + suffix,
+                st.predicate,
+                literal ? st.object : st.object + suffix
+            });
+        }
+    }
+    return res;
+}
+
+namespace {
+
+// N-Triples form of a scaledSample term
+std::string ntriplesTerm(const std::string &term, bool object) {
+    if (term.compare(0, 4, "node") == 0) {
+        return "_:" + term;
+    }
+    if (object && term.find(':') == std::string::npos) {
+        return "\"" + term + "\"";
+    }
+    if (term.compare(0, 7, "http://") == 0) {
+        return "<" + term + ">";
+    }
+    return "<http://example.org/" + term + ">";
+}
+
+} // namespace
+
+std::string scaledNTriples(size_t copies) {
+    std::string res;
+    for (auto &st : scaledSample(copies)) {
+        res += ntriplesTerm(st.subject, false) + " " +
+               ntriplesTerm(st.predicate, false) + " " +
+               ntriplesTerm(st.object, true) + " .\n";
+    }
+    return res;
+}
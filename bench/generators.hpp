@@ -0,0 +1,38 @@
+#pragma once
+
+#include "automaton.hpp"
+#include "graph.hpp"
+#include <string>
+#include <vector>
+
+// synthetic inputs shared by the benchmarks, all deterministic in their seed
+
+// n random '0' and '1' characters
+std::string randomBinary(size_t n, unsigned seed);
+
+// random regex over the given symbols with nesting up to depth,
+// using every operator of the supported syntax
+std::string randomRegex(int depth, const std::string &symbols, unsigned seed);
+
+// (w1|w2|...|wn)* over random lowercase words
+std::string randomAlternation(int words, unsigned seed);
+
+// random automaton where every state has a transition on most symbols
+DFA randomDFA(int states, int symbols, unsigned seed);
+
+// triples over a vocabulary of n / 4 nodes and 64 predicates,
+// about 10% of them duplicates
+std::vector<Triple> randomTriples(size_t n, unsigned seed = 42);
+
+// random graph with the given average out-degree over ex:p0 .. ex:p7
+DictionaryGraph randomGraph(size_t nodes, size_t degree = 4, unsigned seed = 42);
+
+struct Statement {
+    std::string subject, predicate, object;
+};
+
+// copies of the test/sample.ttl statements, resources renamed per copy
+std::vector<Statement> scaledSample(size_t copies);
+
+// scaledSample as N-Triples text, which is valid Turtle as well
+std::string scaledNTriples(size_t copies);
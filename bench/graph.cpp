@@ -0,0 +1,117 @@
+#include "bench.hpp"
+#include "graph.hpp"
+#include "csr.hpp"
+#include "bulk.hpp"
+#include "generators.hpp"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <tuple>
+
+namespace {
+
+template <typename G>
+void insertAndProbe(BenchState &state, const std::string &name, size_t n, size_t probes) {
+    auto triples = randomTriples(n);
+    G graph;
+
+    state.measure(name + "/addTriple/" + std::to_string(n), n, [&] {
+        for (auto &t : triples) {
+            graph.addTriple(t);
+        }
+    });
+
+    std::mt19937 rng(7);
+    state.measure(name + "/hasTriple/" + std::to_string(n), probes, [&] {
+        size_t found = 0;
+        for (size_t i = 0; i < probes; ++i) {
+            found += graph.hasTriple(triples[rng() % n]);
+        }
+        doNotOptimize(found);
+    });
+}
+
+} // namespace
+
+BENCH(triple_store) {
+    for (size_t n : { state.scaled(1000000), state.scaled(10000000) }) {
+        // hasTriple on the list is a linear scan, keep probe count low
+        insertAndProbe<TripleListGraph>(state, "list", n, 100);
+        insertAndProbe<DictionaryGraph>(state, "dictionary", n, 1000000);
+    }
+}
+
+BENCH(bulk_load) {
+    for (size_t n : { state.scaled(1000000), state.scaled(10000000) }) {
+        auto triples = randomTriples(n);
+        auto label = std::to_string(n);
+
+        // both end with every index built
+        DictionaryGraph incremental;
+        state.measure("load/incremental/" + label, n, [&] {
+            for (auto &t : triples) {
+                incremental.addTriple(t);
+            }
+            incremental.index();
+        });
+
+        DictionaryGraph bulk;
+        state.measure("load/bulk/" + label, n, [&] {
+            BulkLoader loader(bulk);
+            for (auto &t : triples) {
+                loader.addTriple(t);
+            }
+            loader.finish();
+        });
+
+        // runs of a quarter of the input each
+        DictionaryGraph spilled;
+        state.measure("load/bulk/spilled/" + label, n, [&] {
+            BulkLoadOptions options;
+            options.memoryBudget = n / 4 * 2 * sizeof(IdTriple);
+            BulkLoader loader(spilled, options);
+            for (auto &t : triples) {
+                loader.addTriple(t);
+            }
+            loader.finish();
+        });
+    }
+}
+
+BENCH(csr_build) {
+    for (size_t n : { state.scaled(1000000), state.scaled(10000000) }) {
+        DictionaryGraph graph;
+        for (auto &t : randomTriples(n)) {
+            graph.addTriple(t);
+        }
+        auto label = std::to_string(n);
+        auto spo = graph.index().all(IndexOrder::SPO);
+
+        std::vector<IdTriple> triples(spo.begin(), spo.end());
+        std::mt19937 rng(1);
+        std::shuffle(triples.begin(), triples.end(), rng);
+        auto copy = triples;
+
+        state.measure("csr/std::sort/" + label, triples.size(), [&] {
+            std::sort(copy.begin(), copy.end(), [](auto &x, auto &y) {
+                return std::tie(x.object, x.predicate, x.subject) < std::tie(y.object, y.predicate, y.subject);
+            });
+        });
+
+        state.measure("csr/radixSort/" + label, triples.size(), [&] {
+            CsrGraph::radixSort(triples, &IdTriple::object, &IdTriple::predicate, &IdTriple::subject);
+        });
+
+        std::unique_ptr<CsrGraph> csr;
+        state.measure("csr/build/" + label, graph.size(), [&] {
+            csr = std::make_unique<CsrGraph>(graph);
+        });
+
+        std::unique_ptr<PackedAdjacency> packed;
+        state.measure("csr/pack/" + label, graph.size(), [&] {
+            packed = std::make_unique<PackedAdjacency>(*csr);
+        });
+        state.metric("csr/memory/direction/" + label, "bytes", csr->memoryUsage() / 2);
+        state.metric("csr/memory/packed/" + label, "bytes", packed->memoryUsage());
+    }
+}
@@ -0,0 +1,128 @@
+#include "bench.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sys/resource.h>
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+} // namespace
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+size_t BenchState::allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+std::vector<Benchmark> &benchmarks() {
+    static std::vector<Benchmark> all;
+    return all;
+}
+
+size_t BenchState::peakMemory() {
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line); ) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoul(line.substr(6));
+        }
+    }
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void BenchState::resetPeakMemory() {
+    // Linux resets VmHWM to the current RSS, elsewhere this is a no-op
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+void BenchState::report(const std::string &label, size_t ops, double ns, size_t allocs, size_t peakKiB) {
+    if (format == Format::Json) {
+        std::cout << "{\"name\": \"";
+        for (char ch : label) {
+            if (ch == '"' || ch == '\\') std::cout << '\\';
+            std::cout << ch;
+        }
+        std::cout << std::fixed << std::setprecision(3)
+                  << "\", \"ops\": " << ops
+                  << ", \"ns_per_op\": " << ns / ops
+                  << ", \"allocs_per_op\": " << double(allocs) / ops
+                  << ", \"peak_rss_kib\": " << peakKiB
+                  << "}" << std::endl;
+        return;
+    }
+
+    std::cout << std::left << std::setw(48) << label
+              << std::right << std::setw(12) << ops << " ops"
+              << std::setw(14) << std::fixed << std::setprecision(1) << ns / ops << " ns/op"
+              << std::setw(10) << std::setprecision(2) << double(allocs) / ops << " allocs/op"
+              << std::setw(10) << peakKiB << " KiB peak"
+              << std::endl;
+}
+
+void BenchState::metric(const std::string &label, const std::string &unit, double value) {
+    if (format == Format::Json) {
+        std::cout << "{\"name\": \"" << label << "\", \"" << unit << "\": "
+                  << std::fixed << std::setprecision(3) << value << "}" << std::endl;
+        return;
+    }
+
+    std::cout << std::left << std::setw(48) << label
+              << std::right << std::setw(16) << std::fixed << std::setprecision(2) << value
+              << " " << unit << std::endl;
+}
+
+int main(int argc, char **argv) {
+    double scale = 1;
+    auto format = BenchState::Format::Text;
+    std::vector<std::string> filters;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--scale=", 8) == 0) {
+            scale = std::stod(argv[i] + 8);
+        } else if (std::strcmp(argv[i], "--format=json") == 0) {
+            format = BenchState::Format::Json;
+        } else if (std::strcmp(argv[i], "--format=text") == 0) {
+            format = BenchState::Format::Text;
+        } else if (argv[i][0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [--scale=<factor>] [--format=text|json] [name filter...]\n";
+            return 1;
+        } else {
+            filters.push_back(argv[i]);
+        }
+    }
+
+    BenchState state{scale};
+    state.format = format;
+    for (auto &bench : benchmarks()) {
+        bool selected = filters.empty();
+        for (auto &f : filters) {
+            selected |= std::string{bench.name}.find(f) != std::string::npos;
+        }
+        if (selected) {
+            bench.run(state);
+        }
+    }
+    return 0;
+}
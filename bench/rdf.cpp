@@ -0,0 +1,86 @@
+#include "bench.hpp"
+#include "graph.hpp"
+#include "rdf.hpp"
+#include "generators.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <string_view>
+#include <unistd.h>
+#include <zlib.h>
+
+BENCH(rdf_sink) {
+    // what RdfReader::statementSink hands to the graph, minus serd itself
+    auto statements = scaledSample(state.scaled(50000));
+    size_t n = statements.size();
+
+    DictionaryGraph viaTriple;
+    state.measure("sink/Triple/" + std::to_string(n), n, [&] {
+        for (auto &st : statements) {
+            viaTriple.addTriple(Triple {
+                st.subject.c_str(),
+                st.predicate.c_str(),
+                st.object.c_str()
+            });
+        }
+    });
+
+    DictionaryGraph viaView;
+    state.measure("sink/string_view/" + std::to_string(n), n, [&] {
+        for (auto &st : statements) {
+            viaView.addStatement(st.subject, st.predicate, st.object);
+        }
+    });
+}
+
+BENCH(rdf_load) {
+    auto copies = state.scaled(50000);
+    auto text = scaledNTriples(copies);
+    size_t n = copies * 18;
+
+    for (auto format : { RdfFormat::NTriples, RdfFormat::Turtle }) {
+        auto name = format == RdfFormat::NTriples ? "ntriples" : "turtle";
+        DictionaryGraph graph;
+        RdfReader reader(format, graph);
+        state.measure(std::string("RdfReader::readString/") + name + "/" + std::to_string(n), n, [&] {
+            reader.readString(text);
+        });
+    }
+
+    char path[] = "/tmp/graphdb-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return;
+    ::close(fd);
+    std::ofstream(path) << text;
+
+    DictionaryGraph graph;
+    RdfReader reader(RdfFormat::NTriples, graph);
+    state.measure("RdfReader::readFileParallel/" + std::to_string(n), n, [&] {
+        reader.readFileParallel(path);
+    });
+
+    DictionaryGraph streamed;
+    RdfReader streamReader(RdfFormat::NTriples, streamed);
+    state.measure("RdfReader::readStream/" + std::to_string(n), n, [&] {
+        int in = ::open(path, O_RDONLY);
+        streamReader.readStream(in);
+        ::close(in);
+    });
+
+    std::string gzPath = std::string(path) + ".gz";
+    if (auto gz = gzopen(gzPath.c_str(), "wb1")) {
+        gzwrite(gz, text.data(), text.size());
+        gzclose(gz);
+    }
+    for (auto file : { std::string(path), gzPath }) {
+        DictionaryGraph graph;
+        RdfReader reader(RdfFormat::NTriples, graph);
+        auto name = file == gzPath ? "gzip" : "plain";
+        state.measure(std::string("RdfReader::readFile/") + name + "/" + std::to_string(n), n, [&] {
+            reader.readFile(file);
+        });
+    }
+    std::remove(gzPath.c_str());
+    std::remove(path);
+}
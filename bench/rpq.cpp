@@ -0,0 +1,67 @@
+#include "bench.hpp"
+#include "rpq.hpp"
+#include "generators.hpp"
+#include "parallel.hpp"
+
+BENCH(rpq) {
+    auto regex = "<ex:p0>(<ex:p1>|<ex:p2>)*<ex:p3>";
+
+    for (size_t n : { state.scaled(10000), state.scaled(1000000) }) {
+        auto graph = randomGraph(n);
+        CsrGraph csr(graph);
+        PathQuery query(csr, graph.terms().view(), regex);
+        auto label = std::to_string(n);
+
+        state.measure("rpq/single/" + label, 100, [&] {
+            size_t pairs = 0;
+            for (int i = 0; i < 100; ++i) {
+                pairs += query.evaluate(graph.terms().find("ex:n" + std::to_string(i))).size();
+            }
+            doNotOptimize(pairs);
+        });
+    }
+
+    // closure over a giant component, every source reaches most nodes
+    auto closure = "<ex:p0>(<ex:p1>|<ex:p2>|<ex:p3>)*";
+    for (size_t n : { state.scaled(1000), state.scaled(10000) }) {
+        auto graph = randomGraph(n);
+        CsrGraph csr(graph);
+        PathQuery query(csr, graph.terms().view(), closure);
+        auto label = std::to_string(n);
+
+        state.measure("rpq/all/per-source/" + label, 1, [&] {
+            size_t pairs = 0;
+            for (TermId v = 0; v < csr.termCount(); ++v) {
+                pairs += query.evaluate(v).size();
+            }
+            doNotOptimize(pairs);
+        });
+
+        state.measure("rpq/all/batched/" + label, 1, [&] {
+            doNotOptimize(query.evaluate().size());
+        });
+
+        PathQuery matrix(csr, graph.terms().view(), closure, PathEngine::Matrix);
+        state.measure("rpq/all/matrix/" + label, 1, [&] {
+            doNotOptimize(matrix.evaluate().size());
+        });
+    }
+}
+
+BENCH(rpq_parallel) {
+    // strong scaling of one single-source query over a closure
+    auto graph = randomGraph(state.scaled(1000000));
+    CsrGraph csr(graph);
+    PathQuery query(csr, graph.terms().view(), "(<ex:p1>|<ex:p2>|<ex:p3>)*<ex:p0>");
+    auto start = graph.terms().find("ex:n0");
+
+    state.measure("rpq/sequential/" + std::to_string(csr.edgeCount()), 1, [&] {
+        doNotOptimize(query.evaluate(start).size());
+    });
+
+    for (unsigned threads = 1; threads <= threadCount(0) * 2; threads *= 2) {
+        state.measure("rpq/parallel/" + std::to_string(csr.edgeCount()) + "/threads=" + std::to_string(threads), 1, [&] {
+            doNotOptimize(query.evaluateParallel(start, threads).size());
+        });
+    }
+}
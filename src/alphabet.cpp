@@ -0,0 +1,74 @@
+#include "automaton.hpp"
+#include <algorithm>
+
+SymbolClasses::SymbolClasses() : symbols(1) {}
+
+int SymbolClasses::count() const {
+    return symbols.size();
+}
+
+const std::vector<int> &SymbolClasses::members(int c) const {
+    return symbols[c];
+}
+
+int SymbolClasses::representative(int c) const {
+    return symbols[c].front();
+}
+
+SymbolClasses SymbolClasses::intersect(const SymbolClasses &a, const SymbolClasses &b) {
+    SymbolClasses res;
+    std::map<std::pair<int, int>, int> ids;
+
+    res.classes.assign(std::min(a.classes.size(), b.classes.size()), 0);
+    for (int s = 0; s < res.classes.size(); ++s) {
+        std::pair<int, int> key{a.classes[s], b.classes[s]};
+        if (key.first == 0 || key.second == 0) {
+            continue;
+        }
+
+        auto it = ids.find(key);
+        if (it == ids.end()) {
+            it = ids.emplace(key, res.symbols.size()).first;
+            res.symbols.emplace_back();
+        }
+        res.classes[s] = it->second;
+        res.symbols[it->second].push_back(s);
+    }
+
+    return res;
+}
+
+SymbolClasses SymbolClasses::fromSignatures(const std::map<int, std::vector<std::pair<int, int>>> &sigs) {
+    SymbolClasses res;
+    std::map<std::vector<std::pair<int, int>>, int> ids;
+
+    int maxSymbol = sigs.empty() ? -1 : sigs.rbegin()->first;
+    res.classes.assign(maxSymbol + 1, 0);
+
+    for (auto &[symbol, sig] : sigs) {
+        if (sig.empty()) {
+            continue;
+        }
+        auto it = ids.find(sig);
+        if (it == ids.end()) {
+            it = ids.emplace(sig, res.symbols.size()).first;
+            res.symbols.emplace_back();
+        }
+        res.classes[symbol] = it->second;
+        res.symbols[it->second].push_back(symbol);
+    }
+
+    return res;
+}
+
+SymbolClasses DFA::symbolClasses() const {
+    // signature of a symbol: (state, target) for every transition on it
+    std::map<int, std::vector<std::pair<int, int>>> sigs;
+    for (int v = 0; v < size(); ++v) {
+        for (auto &t : transitions(v)) {
+            sigs[t.symbol].emplace_back(v, t.to);
+        }
+    }
+
+    return SymbolClasses::fromSignatures(sigs);
+}
@@ -3,9 +3,15 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <exception>
 #include <iostream>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 // special transitions
 enum {
@@ -18,27 +24,78 @@ class ParseException : public std::exception {
     }
 };
 
+// maps a symbol name written as <name> in a regex to a symbol
+using SymbolResolver = std::function<int(const std::string &name)>;
+
 class DFA;
 class NFA;
+class CompiledDFA;
+class DFACache;
+
+/* Partition of the alphabet into classes of symbols that an automaton
+ * cannot tell apart: two symbols share a class iff every state has the
+ * same transitions on both. Class 0 holds all symbols that have no
+ * transitions at all, including every symbol the automaton never saw.
+ */
+class SymbolClasses {
+public:
+    SymbolClasses();
+
+    int classOf(int symbol) const {
+        return symbol >= 0 && symbol < classes.size() ? classes[symbol] : 0;
+    }
 
+    // number of classes, including class 0
+    int count() const;
+    // symbols of class c > 0, ascending
+    const std::vector<int> &members(int c) const;
+    int representative(int c) const;
+
+    // classes of symbols that both partitions can use, i.e. the common
+    // refinement with every symbol of either class 0 moved to class 0
+    static SymbolClasses intersect(const SymbolClasses &a, const SymbolClasses &b);
+
+    // build classes from per-symbol signatures,
+    // symbols with equal signatures end up in the same class
+    static SymbolClasses fromSignatures(const std::map<int, std::vector<std::pair<int, int>>> &sigs);
+
+private:
+    std::vector<int> classes;
+    std::vector<std::vector<int>> symbols;
+};
+
+/* Deterministic automaton, state 0 is the start state.
+ *
+ * States refer to each other by index. The transitions of all states
+ * live in one arena where every state owns a contiguous run ordered by
+ * symbol, so copying an automaton copies two flat arrays and no state
+ * is allocated on its own. Adding transitions state by state, as all
+ * constructions here do, only ever appends to the arena.
+ */
 class DFA {
     friend class NFA;
+    friend class CompiledDFA;
 
 public:
-    struct Node {
-        std::map<int, Node*> trans;
-        bool term = false;
-    };
-
     DFA() = default;
-    DFA(const DFA& that);
+    DFA(const DFA& that) = default;
     DFA(DFA &&that) = default;
     DFA &operator=(DFA that);
     void swap(DFA &that);
 
     static DFA fromRegex(const std::string &str);
+    static DFA fromRegex(const std::string &str, const SymbolResolver &resolve);
+    // shared automaton from the cache, compiled on the first request
+    static std::shared_ptr<const DFA> fromRegex(const std::string &str, DFACache &cache);
+
+    // builder interface, state 0 is the start state
+    int addState(bool term = false);
+    void addTransition(int from, int symbol, int to);
 
+    SymbolClasses symbolClasses() const;
     void intersect(DFA that);
+    // true if some word is accepted by both, stops at the first such pair
+    bool intersects(const DFA &that) const;
     void stripUnreachable();
     void minimize();
     bool accepts(const std::string &s) const;
@@ -47,7 +104,44 @@ public:
     friend std::ostream &operator<<(std::ostream &os, const DFA &dfa);
 
 private:
-    std::vector<std::unique_ptr<Node>> nodes;
+    struct Transition {
+        int symbol;
+        int to;
+    };
+
+    // transitions of a state are trans[first, last)
+    struct State {
+        int32_t first = 0, last = 0;
+        bool term = false;
+    };
+
+    struct Range {
+        const Transition *first, *last;
+
+        const Transition *begin() const { return first; }
+        const Transition *end() const { return last; }
+    };
+
+    Range transitions(int state) const {
+        return { trans.data() + states[state].first, trans.data() + states[state].last };
+    }
+
+    // target of the transition on symbol, -1 if there is none
+    int next(int state, int symbol) const;
+
+    // state v becomes state index[v] and -1 drops it. States sharing an
+    // index are merged into the first of them, which must appear in
+    // ascending index order. Transitions into dropped states are removed.
+    void renumber(const std::vector<int> &index);
+
+    // reachable part of the product automaton, if found is given the
+    // search stops as soon as an accepting pair shows up and sets it
+    static DFA product(const DFA &a, const DFA &b, bool *found);
+
+    std::vector<State> states;
+    std::vector<Transition> trans;
+    // arena entries left behind by runs that moved to the end
+    size_t unused = 0;
 };
 
 
@@ -55,18 +149,15 @@ class NFA {
     friend class DFA;
 
 public:
-    struct Node {
-        std::multimap<int, Node*> trans;
-        bool term = false;
-    };
-
     NFA();
-    NFA(const NFA& that);
+    NFA(const NFA& that) = default;
     NFA(NFA &&that) = default;
     NFA &operator=(NFA that);
     void swap(NFA &that);
 
     static NFA fromRegex(const std::string &str);
+    // symbols are named, a plain character c stands for the name "c"
+    static NFA fromRegex(const std::string &str, const SymbolResolver &resolve);
 
     void intersect(const DFA& that);
     void addCharacter(int c);
@@ -78,17 +169,145 @@ public:
     friend std::ostream &operator<<(std::ostream &os, const NFA &nfa);
 
 private:
-    /* fromRegex helper functions for LL(1) parser
+    /* fromRegex parser for the grammar
      *   expr  ::= EPS | <seq> | <seq> '|' <expr>
      *   seq   ::= <star> | <star> <seq>
      *   star  ::= <unit> | <unit> '*'
-     *   unit  ::= <char> | '(' <expr> ')'
+     *   unit  ::= <char> | <name> | '(' <expr> ')'
      *   char  ::= anything but EOF, '|', '*', '(', ')'
+     *   name  ::= '<' anything but '>' '>', only with a resolver
+     *
+     * The parser keeps open groups on an explicit stack, so deeply
+     * nested or very long expressions cannot overflow the call stack.
+     * Operands become Thompson fragments built in place, with one entry
+     * and one exit state each, so every operator adds a constant number
+     * of states and edges and construction is linear.
      */
-    static NFA fromExpr(std::istream &s);
-    static NFA fromSeq(std::istream &s);
-    static NFA fromStar(std::istream &s);
-    static NFA fromUnit(std::istream &s);
+    static NFA parse(const std::string &str, const SymbolResolver *resolve);
+
+    struct Edge {
+        int from;
+        int symbol;
+        int to;
+    };
+
+    // appends the states of that after the own ones, returns their offset
+    int append(const NFA &that);
+    // edges grouped by source state, returns the offset of every group
+    std::vector<int> sortedEdges(std::vector<Edge> &sorted) const;
+
+    // States are indexes into term and the edges of all states share one
+    // array, so combining fragments shifts and appends flat arrays.
+    std::vector<char> term;
+    std::vector<Edge> edges;
+    int start = 0;
+};
+
+
+/* Immutable DFA with a dense transition table.
+ *
+ * States are numbered from 0 (the start state), symbols are mapped to
+ * symbol classes and the table stores the next state for every
+ * (state, class) pair. Missing transitions lead to an explicit
+ * non-accepting dead state, so stepping never branches.
+ *
+ * Batches of strings run in interleaved lanes: every iteration steps
+ * several independent strings, so the table lookups of one lane
+ * overlap with those of the others instead of waiting for each other.
+ * Built with AVX2 (make AVX2=1) the lanes step together using gathers.
+ */
+class CompiledDFA {
+public:
+    explicit CompiledDFA(const DFA &dfa);
+
+    int32_t start() const {
+        return 0;
+    }
+
+    int32_t dead() const {
+        return states - 1;
+    }
+
+    int32_t symbolClass(int symbol) const {
+        return alphabet.classOf(symbol);
+    }
+
+    int32_t next(int32_t state, int symbol) const {
+        return table[state * classes + symbolClass(symbol)];
+    }
+
+    bool accepting(int32_t state) const {
+        return (accept[state >> 6] >> (state & 63)) & 1;
+    }
+
+    bool accepts(const std::string &s) const;
+    // accepts for count strings at once, out[i] becomes 0 or 1
+    void accepts(const std::string_view *strings, size_t count, char *out) const;
+
+    // number of states including the dead state
+    int size() const;
+    int classCount() const;
+
+private:
+    int32_t states;
+    int32_t classes;
+    SymbolClasses alphabet;
+    // next state, indexed by state * classes + class
+    std::vector<int32_t> table;
+    std::vector<uint64_t> accept;
+    // table with every target scaled to the offset of its row,
+    // which keeps the multiplication out of the byte loops
+    std::vector<int32_t> rows;
+    // symbol class of every byte
+    std::vector<int32_t> byteClasses;
+};
+
+
+struct DFACacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    // automata held right now
+    size_t size = 0;
+};
+
+/* Thread-safe LRU cache of minimal automata for regexes.
+ *
+ * Entries are immutable and shared, a lookup hands out a reference to
+ * the cached automaton instead of a copy and evicting an entry never
+ * invalidates automata still in use. Regexes are compiled outside the
+ * lock, so a slow compilation does not hold up other lookups; threads
+ * missing on the same regex at once may each compile it, the first
+ * to finish wins. Invalid regexes throw ParseException and are not
+ * cached.
+ *
+ * Symbol names are resolved with the resolver the cache was made
+ * with, so a cache belongs to one symbol mapping such as the predicates
+ * of one graph.
+ */
+class DFACache {
+public:
+    explicit DFACache(size_t capacity = 1024, SymbolResolver resolve = {});
+    DFACache(const DFACache &that) = delete;
+    DFACache &operator=(const DFACache &that) = delete;
+
+    std::shared_ptr<const DFA> get(const std::string &regex);
+    DFACacheStats stats() const;
+    void clear();
+
+    // cache key of a regex: parentheses around the whole expression are
+    // dropped, they never change the language or whether it parses
+    static std::string normalize(const std::string &regex, bool names = false);
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const DFA>>;
+
+    size_t capacity;
+    SymbolResolver resolve;
 
-    std::vector<std::unique_ptr<Node>> nodes;
+    mutable std::mutex mutex;
+    // most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> lookup;
+    DFACacheStats counters;
 };
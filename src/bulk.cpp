@@ -0,0 +1,209 @@
+#include "bulk.hpp"
+#include "csr.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <unistd.h>
+
+namespace {
+
+bool spoLess(const IdTriple &a, const IdTriple &b) {
+    return std::tie(a.subject, a.predicate, a.object) <
+           std::tie(b.subject, b.predicate, b.object);
+}
+
+// sorted triples read back from a run file one block at a time
+struct RunCursor {
+    std::FILE *file;
+    size_t left;
+    std::vector<IdTriple> block;
+    size_t pos = 0;
+
+    const IdTriple &head() const {
+        return block[pos];
+    }
+
+    // returns false once the run is exhausted
+    bool advance() {
+        if (++pos < block.size()) {
+            return true;
+        }
+        size_t n = std::min(left, block.capacity());
+        block.resize(n);
+        pos = 0;
+        if (n == 0) {
+            return false;
+        }
+        if (std::fread(block.data(), sizeof(IdTriple), n, file) != n) {
+            throw std::runtime_error("cannot read sorted run");
+        }
+        left -= n;
+        return true;
+    }
+};
+
+} // namespace
+
+BulkLoader::BulkLoader(DictionaryGraph &target, const BulkLoadOptions &options) :
+    target(target),
+    options(options),
+    // the radix sort needs as much scratch space as it sorts
+    capacity(std::max<size_t>(1, options.memoryBudget / (2 * sizeof(IdTriple)))) {}
+
+void BulkLoader::addTriple(const Triple &triple) {
+    addStatement(triple.subject, triple.predicate, triple.object);
+}
+
+bool BulkLoader::hasTriple(const Triple &triple) const {
+    return target.hasTriple(triple);
+}
+
+std::unique_ptr<TripleCursor> BulkLoader::match(const TriplePattern &pattern) const {
+    return target.match(pattern);
+}
+
+void BulkLoader::addTriples(const TripleBuffer &buffer) {
+    auto &dictionary = target.dictionary;
+    std::vector<TermId> remap(buffer.terms.size());
+    for (TermId id = 0; id < remap.size(); ++id) {
+        remap[id] = dictionary.intern(buffer.terms.term(id));
+    }
+
+    for (auto &t : buffer.triples) {
+        add(IdTriple {
+            remap[t.subject],
+            remap[t.predicate],
+            remap[t.object]
+        });
+    }
+}
+
+void BulkLoader::addStatement(std::string_view subject, std::string_view predicate, std::string_view object) {
+    auto &dictionary = target.dictionary;
+    add(IdTriple {
+        dictionary.intern(subject),
+        dictionary.intern(predicate),
+        dictionary.intern(object)
+    });
+}
+
+void BulkLoader::add(const IdTriple &triple) {
+    buffer.push_back(triple);
+    if (buffer.size() >= capacity) {
+        spill();
+    }
+}
+
+void BulkLoader::sortBuffer() {
+    CsrGraph::radixSort(buffer, &IdTriple::subject, &IdTriple::predicate, &IdTriple::object, options.threads);
+    buffer.erase(std::unique(buffer.begin(), buffer.end()), buffer.end());
+}
+
+void BulkLoader::spill() {
+    sortBuffer();
+
+    std::string path = options.tempDirectory + "/graphdb-run-XXXXXX";
+    int fd = ::mkstemp(&path[0]);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "cannot create " + path);
+    }
+    // the file lives on as long as it is open
+    ::unlink(path.c_str());
+    File file{ ::fdopen(fd, "w+b"), std::fclose };
+    if (!file) {
+        ::close(fd);
+        throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+    }
+
+    if (std::fwrite(buffer.data(), sizeof(IdTriple), buffer.size(), file.get()) != buffer.size() ||
+        std::fflush(file.get()) != 0) {
+        throw std::system_error(errno, std::generic_category(), "cannot write " + path);
+    }
+    runs.push_back({ std::move(file), buffer.size() });
+    buffer.clear();
+}
+
+std::vector<IdTriple> BulkLoader::merge() {
+    sortBuffer();
+    if (runs.empty()) {
+        return std::move(buffer);
+    }
+
+    // the memory of a full buffer is shared among the runs
+    size_t blockSize = std::max<size_t>(4096, (capacity - buffer.size()) / runs.size());
+    std::vector<RunCursor> cursors;
+    cursors.reserve(runs.size() + 1);
+    for (auto &run : runs) {
+        std::rewind(run.file.get());
+        cursors.push_back({ run.file.get(), run.size, {}, 0 });
+        cursors.back().block.reserve(blockSize);
+    }
+
+    auto greater = [&](size_t a, size_t b) {
+        return spoLess(cursors[b].head(), cursors[a].head());
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (cursors[i].advance()) {
+            heap.push(i);
+        }
+    }
+
+    // the unspilled rest takes part as a run that is already loaded
+    if (!buffer.empty()) {
+        cursors.push_back({ nullptr, 0, std::move(buffer), 0 });
+        heap.push(cursors.size() - 1);
+    }
+
+    std::vector<IdTriple> merged;
+    while (!heap.empty()) {
+        size_t i = heap.top();
+        heap.pop();
+        auto &t = cursors[i].head();
+        if (merged.empty() || !(merged.back() == t)) {
+            merged.push_back(t);
+        }
+        if (cursors[i].advance()) {
+            heap.push(i);
+        }
+    }
+
+    runs.clear();
+    buffer = {};
+    return merged;
+}
+
+void BulkLoader::finish() {
+    auto sorted = merge();
+
+    // pending incremental inserts go into the indexes the usual way
+    target.index();
+
+    size_t before = target.encoded.size();
+    target.unique.reserve(before + sorted.size());
+    for (auto &t : sorted) {
+        if (target.unique.insert(t)) {
+            target.encoded.push_back(t);
+        }
+    }
+    if (before != 0) {
+        // keep the triples that were new, still in SPO order
+        sorted.assign(target.encoded.begin() + before, target.encoded.end());
+    }
+
+    auto &indexes = target.indexes;
+    auto threads = options.threads;
+    indexes.insertSorted(IndexOrder::SPO, sorted);
+    CsrGraph::radixSort(sorted, &IdTriple::predicate, &IdTriple::object, &IdTriple::subject, threads);
+    indexes.insertSorted(IndexOrder::POS, sorted);
+    CsrGraph::radixSort(sorted, &IdTriple::object, &IdTriple::subject, &IdTriple::predicate, threads);
+    indexes.insertSorted(IndexOrder::OSP, sorted);
+}
+
+size_t BulkLoader::spilledRuns() const {
+    return runs.size();
+}
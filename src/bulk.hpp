@@ -0,0 +1,76 @@
+#pragma once
+
+#include "graph.hpp"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct BulkLoadOptions {
+    // bytes of id triples held in memory, sort space included, before
+    // a sorted run is written to disk
+    size_t memoryBudget = size_t(1) << 30;
+    // where sorted runs are spilled, the files are unlinked right away
+    std::string tempDirectory = "/tmp";
+    // threads == 0 means one thread per hardware core
+    unsigned threads = 0;
+};
+
+/* Loads many triples into a DictionaryGraph at once.
+ *
+ * Terms are interned as they arrive, triples only go into a buffer.
+ * A full buffer is radix sorted, deduplicated and spilled to disk as
+ * a sorted run. finish merges the runs with the rest of the buffer
+ * and builds the triple set and every permutation index in one go
+ * instead of hashing and merging triple by triple.
+ *
+ * The loader is a Graph, so parsers write into it directly:
+ *
+ *     BulkLoader loader(graph);
+ *     RdfReader(RdfFormat::NTriples, loader).readFile("dump.nt.gz");
+ *     loader.finish();
+ *
+ * The target ends up with the same terms, ids and triples as after
+ * incremental inserts, except that triples() lists the new triples in
+ * SPO order instead of input order. Queries through the loader see
+ * the target as of the last finish. Triples not finished when the
+ * loader is destroyed are dropped.
+ */
+class BulkLoader : public Graph {
+public:
+    explicit BulkLoader(DictionaryGraph &target, const BulkLoadOptions &options = {});
+    BulkLoader(const BulkLoader &that) = delete;
+    BulkLoader &operator=(const BulkLoader &that) = delete;
+
+    void addTriple(const Triple &triple) override;
+    bool hasTriple(const Triple &triple) const override;
+    std::unique_ptr<TripleCursor> match(const TriplePattern &pattern) const override;
+    void addTriples(const TripleBuffer &buffer) override;
+    void addStatement(std::string_view subject, std::string_view predicate, std::string_view object) override;
+
+    // adds everything loaded so far to the target
+    void finish();
+
+    // number of runs written to disk since the last finish
+    size_t spilledRuns() const;
+
+private:
+    using File = std::unique_ptr<std::FILE, int(*)(std::FILE*)>;
+
+    struct Run {
+        File file;
+        size_t size;
+    };
+
+    void add(const IdTriple &triple);
+    // sorts and deduplicates the buffer in SPO order
+    void sortBuffer();
+    void spill();
+    std::vector<IdTriple> merge();
+
+    DictionaryGraph &target;
+    BulkLoadOptions options;
+    size_t capacity;
+    std::vector<IdTriple> buffer;
+    std::vector<Run> runs;
+};
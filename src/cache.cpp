@@ -0,0 +1,75 @@
+#include "automaton.hpp"
+
+DFACache::DFACache(size_t capacity, SymbolResolver resolve) :
+    capacity(capacity), resolve(std::move(resolve)) {}
+
+std::shared_ptr<const DFA> DFACache::get(const std::string &regex) {
+    auto key = normalize(regex, bool(resolve));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = lookup.find(key);
+        if (it != lookup.end()) {
+            ++counters.hits;
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->second;
+        }
+        ++counters.misses;
+    }
+
+    std::shared_ptr<const DFA> dfa = std::make_shared<DFA>(
+        resolve ? DFA::fromRegex(key, resolve) : DFA::fromRegex(key));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = lookup.find(key);
+    if (it != lookup.end()) {
+        // compiled by another thread in the meantime
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+    entries.emplace_front(key, dfa);
+    lookup.emplace(std::move(key), entries.begin());
+    while (entries.size() > capacity) {
+        lookup.erase(entries.back().first);
+        entries.pop_back();
+        ++counters.evictions;
+    }
+    return dfa;
+}
+
+DFACacheStats DFACache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto res = counters;
+    res.size = entries.size();
+    return res;
+}
+
+void DFACache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lookup.clear();
+}
+
+std::string DFACache::normalize(const std::string &regex, bool names) {
+    size_t first = 0, last = regex.size();
+    while (last - first >= 2 && regex[first] == '(' && regex[last - 1] == ')') {
+        // the opening parenthesis has to be closed by the last one
+        int depth = 0;
+        size_t i = first;
+        for (; i < last; ++i) {
+            char ch = regex[i];
+            if (names && ch == '<') {
+                auto end = regex.find('>', i + 1);
+                if (end == std::string::npos || end >= last) break;
+                i = end;
+            } else if (ch == '(') {
+                ++depth;
+            } else if (ch == ')' && --depth == 0) {
+                break;
+            }
+        }
+        if (i != last - 1) break;
+        ++first;
+        --last;
+    }
+    return regex.substr(first, last - first);
+}
@@ -0,0 +1,238 @@
+#include "cfpq.hpp"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace {
+
+uint64_t key(TermId node, uint32_t nonterminal) {
+    return uint64_t(node) << 32 | nonterminal;
+}
+
+// drops whitespace outside of <...>
+std::string compact(const std::string &s) {
+    std::string res;
+    bool name = false;
+    for (char ch : s) {
+        if (ch == '<') name = true;
+        if (ch == '>') name = false;
+        if (name || !std::isspace((unsigned char)ch)) {
+            res.push_back(ch);
+        }
+    }
+    return res;
+}
+
+} // namespace
+
+Grammar Grammar::fromString(const std::string &text) {
+    Grammar grammar;
+    std::istringstream s{text};
+    std::string line;
+    while (std::getline(s, line)) {
+        auto body = compact(line);
+        if (body.empty() || body[0] == '#') continue;
+
+        auto arrow = line.find("->");
+        if (arrow == std::string::npos) {
+            throw ParseException{};
+        }
+        auto head = compact(line.substr(0, arrow));
+        if (head.size() > 1 && head.front() == '<' && head.back() == '>') {
+            head = head.substr(1, head.size() - 2);
+        }
+        if (head.empty()) {
+            throw ParseException{};
+        }
+        grammar.addRule(head, line.substr(arrow + 2));
+    }
+    if (grammar.heads.empty()) {
+        throw ParseException{};
+    }
+    return grammar;
+}
+
+void Grammar::addRule(const std::string &head, const std::string &body) {
+    auto [it, inserted] = bodies.emplace(head, "(" + compact(body) + ")");
+    if (inserted) {
+        heads.push_back(head);
+    } else {
+        it->second += "|(" + compact(body) + ")";
+    }
+}
+
+const std::string &Grammar::start() const {
+    return heads.front();
+}
+
+const std::vector<std::string> &Grammar::nonterminals() const {
+    return heads;
+}
+
+const std::string &Grammar::body(const std::string &head) const {
+    return bodies.at(head);
+}
+
+ContextFreeQuery::ContextFreeQuery(const CsrGraph &graph, const TermDictionaryView &terms, const Grammar &grammar) :
+    graph(graph) {
+
+    // symbols: 2p walks predicate p forwards, 2p + 1 backwards, the
+    // pair after the last predicate is for unknown terms and the
+    // nonterminals come last
+    uint32_t predicates = graph.predicateCount();
+    auto &heads = grammar.nonterminals();
+    std::unordered_map<std::string, uint32_t> nonterminals;
+    for (auto &head : heads) {
+        nonterminals.emplace(head, nonterminals.size());
+    }
+
+    auto resolve = [&](const std::string &name) {
+        auto it = nonterminals.find(name);
+        if (it != nonterminals.end()) {
+            return int(2 * (predicates + 1) + it->second);
+        }
+        bool inverse = !name.empty() && name[0] == '^';
+        auto id = terms.find(inverse ? name.substr(1) : name);
+        uint32_t p = id == TermDictionaryView::NoTerm ? predicates : graph.predicateIndex(id);
+        return int(2 * p + inverse);
+    };
+
+    for (auto &head : heads) {
+        base.push_back(owner.size());
+        automata.emplace_back(DFA::fromRegex(grammar.body(head), resolve));
+        owner.resize(owner.size() + automata.back().size() - 1, automata.size() - 1);
+    }
+
+    calls.resize(owner.size());
+    for (uint32_t n = 0; n < automata.size(); ++n) {
+        auto &dfa = automata[n];
+        for (int32_t q = 0; q < dfa.dead(); ++q) {
+            for (uint32_t m = 0; m < automata.size(); ++m) {
+                auto to = dfa.next(q, 2 * (predicates + 1) + m);
+                if (to != dfa.dead()) {
+                    calls[base[n] + q].emplace_back(m, base[n] + to);
+                }
+            }
+        }
+    }
+}
+
+std::vector<NodePair> ContextFreeQuery::evaluate() const {
+    std::vector<TermId> starts;
+    for (TermId v = 0; v < graph.termCount(); ++v) {
+        if (graph.hasNode(v)) {
+            starts.push_back(v);
+        }
+    }
+    return evaluate(starts);
+}
+
+std::vector<NodePair> ContextFreeQuery::evaluate(TermId start) const {
+    return evaluate(std::vector<TermId>{ start });
+}
+
+std::vector<NodePair> ContextFreeQuery::evaluate(const std::vector<TermId> &starts) const {
+    std::vector<TermId> sources;
+    for (auto v : starts) {
+        if (v < graph.termCount() && graph.hasNode(v)) {
+            sources.push_back(v);
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+    sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+    Search state;
+    for (auto v : sources) {
+        start(state, v, 0);
+    }
+
+    while (!state.worklist.empty()) {
+        auto config = state.worklist.back();
+        state.worklist.pop_back();
+        step(state, config);
+    }
+
+    std::vector<NodePair> res;
+    for (auto u : sources) {
+        auto it = state.ends.find(key(u, 0));
+        if (it == state.ends.end()) continue;
+
+        auto first = res.size();
+        for (auto v : it->second) {
+            res.emplace_back(u, v);
+        }
+        std::sort(res.begin() + first, res.end());
+    }
+    return res;
+}
+
+void ContextFreeQuery::add(Search &state, TermId u, uint32_t s, TermId v) const {
+    IdTriple config{ u, s, v };
+    if (state.configs.insert(config)) {
+        state.worklist.push_back(config);
+    }
+}
+
+void ContextFreeQuery::start(Search &state, TermId v, uint32_t nonterminal) const {
+    if (state.started.insert(key(v, nonterminal)).second) {
+        add(state, v, base[nonterminal], v);
+    }
+}
+
+void ContextFreeQuery::summarize(Search &state, TermId u, uint32_t nonterminal, TermId v) const {
+    if (!state.summaries.insert({ u, nonterminal, v })) {
+        return;
+    }
+
+    state.ends[key(u, nonterminal)].push_back(v);
+    auto it = state.waiting.find(key(u, nonterminal));
+    if (it != state.waiting.end()) {
+        for (auto [x, s] : it->second) {
+            add(state, x, s, v);
+        }
+    }
+}
+
+void ContextFreeQuery::step(Search &state, const IdTriple &config) const {
+    auto [u, s, v] = config;
+    auto n = owner[s];
+    auto &dfa = automata[n];
+    int32_t q = s - base[n];
+
+    if (dfa.accepting(q)) {
+        summarize(state, u, n, v);
+    }
+
+    // terminals, edges are grouped by predicate
+    auto follow = [&](const CsrEdge *first, const CsrEdge *last, uint32_t inverse) {
+        for (auto e = first; e != last; ) {
+            auto predicate = e->predicate;
+            auto to = dfa.next(q, 2 * predicate + inverse);
+            if (to == dfa.dead()) {
+                while (e != last && e->predicate == predicate) ++e;
+                continue;
+            }
+            for (; e != last && e->predicate == predicate; ++e) {
+                add(state, u, base[n] + to, e->target);
+            }
+        }
+    };
+
+    auto out = graph.edges(v);
+    auto in = graph.reverseEdges(v);
+    follow(out.begin(), out.end(), 0);
+    follow(in.begin(), in.end(), 1);
+
+    // nonterminals
+    for (auto [m, to] : calls[s]) {
+        start(state, v, m);
+        state.waiting[key(v, m)].emplace_back(u, to);
+
+        auto it = state.ends.find(key(v, m));
+        if (it == state.ends.end()) continue;
+        // add never touches ends, so iterating it here is safe
+        for (auto w : it->second) {
+            add(state, u, to, w);
+        }
+    }
+}
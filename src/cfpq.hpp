@@ -0,0 +1,95 @@
+#pragma once
+
+#include "automaton.hpp"
+#include "csr.hpp"
+#include "index.hpp"
+#include "rpq.hpp"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* Context-free grammar over predicates, one rule per line:
+ *
+ *   S -> <subClassOf> S <^subClassOf> | <subClassOf> <^subClassOf>
+ *
+ * Rule bodies are regular expressions in the PathQuery syntax, so the
+ * grammar is a recursive state machine with one automaton per
+ * nonterminal. A name that is the head of some rule is a nonterminal,
+ * ^name walks a predicate edge backwards. Whitespace outside <...> is
+ * ignored, lines starting with # are comments. The head of the first
+ * rule is the start nonterminal; several rules for one head are
+ * alternatives.
+ */
+class Grammar {
+public:
+    static Grammar fromString(const std::string &text);
+
+    void addRule(const std::string &head, const std::string &body);
+
+    const std::string &start() const;
+    // nonterminals in order of their first rule
+    const std::vector<std::string> &nonterminals() const;
+    // the bodies of all rules for head joined into one expression
+    const std::string &body(const std::string &head) const;
+
+private:
+    std::vector<std::string> heads;
+    std::unordered_map<std::string, std::string> bodies;
+};
+
+/* Context-free path query: every pair of nodes joined by a path whose
+ * predicates spell a word derivable from the start nonterminal.
+ *
+ * Evaluation is CFL-reachability with summaries over the recursive
+ * state machine. A configuration (u, s, v) says that the automaton
+ * of some nonterminal N, started at node u, is in state s at node v.
+ * Configurations are processed from a worklist: terminal transitions
+ * follow graph edges, a nonterminal transition on M at v waits for
+ * summaries (v, M, w) and asks for M to be started at v. When an
+ * accepting state is reached the summary (u, N, v) is recorded and
+ * handed to everyone waiting on (u, N).
+ *
+ * Nonterminals are only started at nodes where they are needed, so
+ * memory follows the configurations that actually occur.
+ */
+class ContextFreeQuery {
+public:
+    ContextFreeQuery(const CsrGraph &graph, const TermDictionaryView &terms, const Grammar &grammar);
+
+    // pairs for every start node, sorted
+    std::vector<NodePair> evaluate() const;
+    // pairs for a single start node, sorted
+    std::vector<NodePair> evaluate(TermId start) const;
+    // pairs for the given start nodes, sorted
+    std::vector<NodePair> evaluate(const std::vector<TermId> &starts) const;
+
+private:
+    // a configuration (u, s, v) is stored as IdTriple{ u, s, v }
+    struct Search {
+        TripleSet configs;
+        std::vector<IdTriple> worklist;
+        TripleSet summaries;
+        // ends of summaries, by node << 32 | nonterminal
+        std::unordered_map<uint64_t, std::vector<TermId>> ends;
+        // configurations (u, s) waiting for summaries, by node << 32 | nonterminal
+        std::unordered_map<uint64_t, std::vector<std::pair<TermId, uint32_t>>> waiting;
+        std::unordered_set<uint64_t> started;
+    };
+
+    void add(Search &state, TermId u, uint32_t s, TermId v) const;
+    void start(Search &state, TermId v, uint32_t nonterminal) const;
+    void summarize(Search &state, TermId u, uint32_t nonterminal, TermId v) const;
+    void step(Search &state, const IdTriple &config) const;
+
+    const CsrGraph &graph;
+
+    // one automaton per nonterminal, the start nonterminal is 0;
+    // states of all of them are numbered globally from base[n]
+    std::vector<CompiledDFA> automata;
+    std::vector<uint32_t> base;
+    // nonterminal owning a global state
+    std::vector<uint32_t> owner;
+    // nonterminal transitions (nonterminal, global target) per global state
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> calls;
+};
@@ -0,0 +1,151 @@
+#include "automaton.hpp"
+#include <algorithm>
+#include <cstring>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// strings stepped together by CompiledDFA::accepts on a batch
+const int Lanes = 8;
+
+} // namespace
+
+CompiledDFA::CompiledDFA(const DFA &dfa) : alphabet(dfa.symbolClasses()) {
+    states = dfa.size() + 1;
+    classes = alphabet.count();
+    table.assign(states * classes, dead());
+    accept.assign((states + 63) / 64, 0);
+
+    for (int v = 0; v < dfa.size(); ++v) {
+        if (dfa.states[v].term) {
+            accept[v >> 6] |= uint64_t(1) << (v & 63);
+        }
+        for (auto &t : dfa.transitions(v)) {
+            table[v * classes + alphabet.classOf(t.symbol)] = t.to;
+        }
+    }
+
+    rows.resize(table.size());
+    for (size_t i = 0; i < table.size(); ++i) {
+        rows[i] = table[i] * classes;
+    }
+    byteClasses.resize(256);
+    for (int c = 0; c < 256; ++c) {
+        byteClasses[c] = alphabet.classOf(c);
+    }
+}
+
+bool CompiledDFA::accepts(const std::string &s) const {
+    int32_t row = start() * classes;
+    for (unsigned char c : s) {
+        row = rows[row + byteClasses[c]];
+    }
+    return accepting(row / classes);
+}
+
+void CompiledDFA::accepts(const std::string_view *strings, size_t count, char *out) const {
+    // lane l runs string index[l], whose next byte is pos[l] and which
+    // has left[l] bytes to go; states are kept as row offsets
+    const unsigned char *pos[Lanes];
+    size_t left[Lanes];
+    size_t index[Lanes];
+    alignas(32) int32_t state[Lanes];
+
+    size_t next = 0;
+    auto load = [&](int l) {
+        index[l] = next;
+        pos[l] = reinterpret_cast<const unsigned char*>(strings[next].data());
+        left[l] = strings[next].size();
+        state[l] = start() * classes;
+        ++next;
+    };
+
+    int lanes = 0;
+    while (lanes < Lanes && next < count) {
+        load(lanes++);
+    }
+
+    for (;;) {
+        // retire lanes that are done, the dead state never leaves
+        size_t steps = size_t(-1);
+        for (int l = 0; l < lanes;) {
+            if (left[l] > 0 && state[l] != dead() * classes) {
+                steps = std::min(steps, left[l]);
+                ++l;
+                continue;
+            }
+            out[index[l]] = accepting(state[l] / classes);
+            if (next < count) {
+                load(l);
+                continue;
+            }
+            // out of strings, the last lane takes the place
+            --lanes;
+            index[l] = index[lanes];
+            pos[l] = pos[lanes];
+            left[l] = left[lanes];
+            state[l] = state[lanes];
+        }
+        if (lanes < Lanes) break;
+
+        // every lane has at least steps bytes left
+        size_t k = 0;
+#ifdef __AVX2__
+        __m256i s = _mm256_load_si256(reinterpret_cast<const __m256i*>(state));
+        const __m256i low = _mm256_set1_epi32(255);
+        auto step = [&](__m256i bytes) {
+            auto cls = _mm256_i32gather_epi32(byteClasses.data(), _mm256_and_si256(bytes, low), 4);
+            s = _mm256_i32gather_epi32(rows.data(), _mm256_add_epi32(s, cls), 4);
+        };
+        auto word = [&](int l) {
+            int32_t w;
+            std::memcpy(&w, pos[l] + k, 4);
+            return w;
+        };
+
+        // four bytes of every lane per load
+        for (; k + 4 <= steps; k += 4) {
+            auto words = _mm256_setr_epi32(word(0), word(1), word(2), word(3),
+                                           word(4), word(5), word(6), word(7));
+            step(words);
+            step(_mm256_srli_epi32(words, 8));
+            step(_mm256_srli_epi32(words, 16));
+            step(_mm256_srli_epi32(words, 24));
+        }
+        for (; k < steps; ++k) {
+            step(_mm256_setr_epi32(pos[0][k], pos[1][k], pos[2][k], pos[3][k],
+                                   pos[4][k], pos[5][k], pos[6][k], pos[7][k]));
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(state), s);
+#else
+        for (; k < steps; ++k) {
+            for (int l = 0; l < Lanes; ++l) {
+                state[l] = rows[state[l] + byteClasses[pos[l][k]]];
+            }
+        }
+#endif
+        for (int l = 0; l < Lanes; ++l) {
+            pos[l] += steps;
+            left[l] -= steps;
+        }
+    }
+
+    // the last strings run one by one
+    for (int l = 0; l < lanes; ++l) {
+        int32_t q = state[l];
+        for (size_t k = 0; k < left[l]; ++k) {
+            q = rows[q + byteClasses[pos[l][k]]];
+        }
+        out[index[l]] = accepting(q / classes);
+    }
+}
+
+int CompiledDFA::size() const {
+    return states;
+}
+
+int CompiledDFA::classCount() const {
+    return classes;
+}
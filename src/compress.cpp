@@ -0,0 +1,202 @@
+#include "compress.hpp"
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef GRAPHDB_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// reads until size bytes are in or the file ends
+size_t readFully(int fd, char *buf, size_t size, const std::string &path) {
+    size_t n = 0;
+    while (n < size) {
+        ssize_t got = ::read(fd, buf + n, size - n);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot read " + path);
+        }
+        if (got == 0) break;
+        n += got;
+    }
+    return n;
+}
+
+} // namespace
+
+DecompressingReader::DecompressingReader(const std::string &path, size_t bufferSize, size_t buffers) :
+    path(path),
+    format(Compression::None),
+    bufferSize(bufferSize),
+    ring(buffers) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+
+    unsigned char magic[4] = {};
+    ssize_t n = ::pread(fd, magic, sizeof magic, 0);
+    if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        format = Compression::Gzip;
+    } else if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        format = Compression::Zstd;
+#ifndef GRAPHDB_ZSTD
+        ::close(fd);
+        throw std::runtime_error(path + ": built without zstd support");
+#endif
+    }
+
+    decoder = std::thread(&DecompressingReader::decode, this, fd);
+}
+
+DecompressingReader::~DecompressingReader() {
+    ring.close();
+    decoder.join();
+}
+
+size_t DecompressingReader::read(char *buf, size_t size) {
+    size_t n = 0;
+    while (n < size) {
+        if (!current) {
+            current = ring.front();
+            offset = 0;
+            if (!current) {
+                if (failure) {
+                    std::rethrow_exception(failure);
+                }
+                break;
+            }
+        }
+
+        size_t count = std::min(size - n, current->size - offset);
+        std::memcpy(buf + n, current->data.data() + offset, count);
+        offset += count;
+        n += count;
+
+        if (offset == current->size) {
+            ring.pop();
+            current = nullptr;
+        }
+    }
+    return n;
+}
+
+Compression DecompressingReader::compression() const {
+    return format;
+}
+
+void DecompressingReader::decode(int fd) {
+    try {
+        switch (format) {
+            case Compression::None:
+                decodeRaw(fd);
+                break;
+
+            case Compression::Gzip:
+                decodeGzip(fd);
+                break;
+
+            case Compression::Zstd:
+                decodeZstd(fd);
+                break;
+        }
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    ::close(fd);
+    ring.finish();
+}
+
+void DecompressingReader::decodeRaw(int fd) {
+    while (auto buffer = ring.back()) {
+        buffer->data.resize(bufferSize);
+        buffer->size = readFully(fd, buffer->data.data(), bufferSize, path);
+        if (buffer->size == 0) return;
+        ring.push();
+        if (buffer->size < bufferSize) return;
+    }
+}
+
+void DecompressingReader::decodeGzip(int fd) {
+    // gzclose closes the descriptor it was given, hand it a copy
+    int copy = ::dup(fd);
+    std::unique_ptr<gzFile_s, decltype(&gzclose)> file{ copy < 0 ? nullptr : gzdopen(copy, "rb"), gzclose };
+    if (!file) {
+        if (copy >= 0) ::close(copy);
+        throw std::runtime_error("cannot read " + path);
+    }
+    gzbuffer(file.get(), 1 << 17);
+
+    while (auto buffer = ring.back()) {
+        buffer->data.resize(bufferSize);
+        int n = gzread(file.get(), buffer->data.data(), bufferSize);
+
+        // a truncated stream only shows up in the error state
+        int code = Z_OK;
+        const char *message = gzerror(file.get(), &code);
+        if (n < 0 || (n == 0 && code != Z_OK)) {
+            throw std::runtime_error(path + ": " + message);
+        }
+        if (n == 0) return;
+
+        buffer->size = n;
+        ring.push();
+    }
+}
+
+void DecompressingReader::decodeZstd(int fd) {
+#ifdef GRAPHDB_ZSTD
+    std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> stream{ ZSTD_createDStream(), ZSTD_freeDStream };
+    if (!stream) {
+        throw std::runtime_error(path + ": cannot create zstd stream");
+    }
+    ZSTD_initDStream(stream.get());
+
+    std::vector<char> input(ZSTD_DStreamInSize());
+    ZSTD_inBuffer in{ input.data(), 0, 0 };
+    // 0 once a frame is complete and flushed
+    size_t pending = 0;
+    bool eof = false;
+
+    while (auto buffer = ring.back()) {
+        buffer->data.resize(bufferSize);
+        ZSTD_outBuffer out{ buffer->data.data(), bufferSize, 0 };
+
+        while (out.pos < out.size) {
+            if (in.pos == in.size && !eof) {
+                in.size = readFully(fd, input.data(), input.size(), path);
+                in.pos = 0;
+                eof = in.size == 0;
+            }
+
+            // at the end of the input this only drains buffered output
+            size_t produced = out.pos, consumed = in.pos;
+            size_t ret = ZSTD_decompressStream(stream.get(), &out, &in);
+            if (ZSTD_isError(ret)) {
+                throw std::runtime_error(path + ": " + ZSTD_getErrorName(ret));
+            }
+            if (out.pos == produced && in.pos == consumed) break;
+            pending = ret;
+        }
+
+        buffer->size = out.pos;
+        if (buffer->size > 0) {
+            ring.push();
+        }
+        if (eof && out.pos < out.size) {
+            if (pending != 0) {
+                throw std::runtime_error(path + ": unexpected end of file");
+            }
+            return;
+        }
+    }
+#else
+    (void)fd;
+#endif
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "parallel.hpp"
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class Compression {
+    None,
+    Gzip,
+    // needs a build with GRAPHDB_ZSTD defined, see the Makefile
+    Zstd
+};
+
+/* Contents of a file, decompressed on a separate thread.
+ *
+ * Gzip and zstd files are recognized by their magic numbers, anything
+ * else is read as is. The decoder thread fills the buffers of a ring
+ * shared with the reader, so decoding the next buffers overlaps with
+ * consuming the current one. Errors of the decoder, such as corrupt
+ * or truncated input, are rethrown by read once the data before them
+ * has been consumed.
+ */
+class DecompressingReader {
+public:
+    explicit DecompressingReader(const std::string &path, size_t bufferSize = 1 << 18, size_t buffers = 8);
+    DecompressingReader(const DecompressingReader &that) = delete;
+    DecompressingReader &operator=(const DecompressingReader &that) = delete;
+    ~DecompressingReader();
+
+    // copies up to size decoded bytes into buf, returns 0 at the end
+    size_t read(char *buf, size_t size);
+
+    Compression compression() const;
+
+private:
+    struct Buffer {
+        std::vector<char> data;
+        size_t size = 0;
+    };
+
+    // decoder thread, owns fd
+    void decode(int fd);
+    void decodeRaw(int fd);
+    void decodeGzip(int fd);
+    void decodeZstd(int fd);
+
+    std::string path;
+    Compression format;
+    size_t bufferSize;
+    SpscRing<Buffer> ring;
+    Buffer *current = nullptr;
+    size_t offset = 0;
+    // set by the decoder before it finishes the ring
+    std::exception_ptr failure;
+    std::thread decoder;
+};
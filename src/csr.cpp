@@ -0,0 +1,217 @@
+#include "csr.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+
+namespace {
+
+CsrRange predicateRange(CsrRange range, uint32_t predicate) {
+    auto first = std::lower_bound(range.begin(), range.end(), predicate, [](const CsrEdge &e, uint32_t p) {
+        return e.predicate < p;
+    });
+    auto last = std::upper_bound(first, range.end(), predicate, [](uint32_t p, const CsrEdge &e) {
+        return p < e.predicate;
+    });
+    return { first, last };
+}
+
+// inputs below this size per thread are sorted on fewer threads
+const size_t MinChunk = 1 << 16;
+
+} // namespace
+
+CsrGraph::CsrGraph(size_t terms, IdRange spo, unsigned threads) {
+    std::vector<IdTriple> triples(spo.begin(), spo.end());
+    build(terms, triples, true, threads);
+}
+
+CsrGraph::CsrGraph(const DictionaryGraph &graph, unsigned threads) :
+    CsrGraph(graph.terms().size(), graph.index().all(IndexOrder::SPO), threads) {}
+
+CsrGraph::CsrGraph(const Graph &graph, TermDictionary &terms, unsigned threads) {
+    std::vector<IdTriple> triples;
+    auto cursor = graph.match(TriplePattern{});
+    for (Triple t; cursor->next(t); ) {
+        triples.push_back({ terms.intern(t.subject), terms.intern(t.predicate), terms.intern(t.object) });
+    }
+    build(terms.size(), triples, false, threads);
+}
+
+void CsrGraph::build(size_t terms, std::vector<IdTriple> &triples, bool sorted, unsigned threads) {
+    if (!sorted) {
+        radixSort(triples, &IdTriple::subject, &IdTriple::predicate, &IdTriple::object, threads);
+        triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+    }
+
+    nodes.assign((terms + 63) / 64, 0);
+    std::vector<uint32_t> dense(terms, 0);
+    for (auto &t : triples) {
+        nodes[t.subject >> 6] |= uint64_t(1) << (t.subject & 63);
+        nodes[t.object >> 6] |= uint64_t(1) << (t.object & 63);
+        dense[t.predicate] = 1;
+    }
+
+    // predicates are numbered in term id order
+    predicates.clear();
+    for (TermId id = 0; id < terms; ++id) {
+        if (dense[id]) {
+            dense[id] = predicates.size();
+            predicates.push_back(id);
+        }
+    }
+
+    // triples are grouped by subject, then predicate, so edges come out
+    // in CSR order and only the offsets need counting
+    forwardOffsets.assign(terms + 1, 0);
+    forward.resize(triples.size());
+    for (size_t i = 0; i < triples.size(); ++i) {
+        auto &t = triples[i];
+        ++forwardOffsets[t.subject + 1];
+        forward[i] = { dense[t.predicate], t.object };
+    }
+
+    radixSort(triples, &IdTriple::object, &IdTriple::predicate, &IdTriple::subject, threads);
+    reverseOffsets.assign(terms + 1, 0);
+    reverse.resize(triples.size());
+    for (size_t i = 0; i < triples.size(); ++i) {
+        auto &t = triples[i];
+        ++reverseOffsets[t.object + 1];
+        reverse[i] = { dense[t.predicate], t.subject };
+    }
+
+    for (size_t i = 0; i < terms; ++i) {
+        forwardOffsets[i + 1] += forwardOffsets[i];
+        reverseOffsets[i + 1] += reverseOffsets[i];
+    }
+}
+
+void CsrGraph::radixSort(std::vector<IdTriple> &triples, TermId IdTriple::*major,
+                         TermId IdTriple::*middle, TermId IdTriple::*minor, unsigned threads) {
+    size_t n = triples.size();
+    threads = std::max<size_t>(1, std::min<size_t>(threadCount(threads), n / MinChunk));
+
+    std::vector<IdTriple> tmp(n);
+    // counts[t * 256 + b] is the number of byte values b in chunk t,
+    // after the prefix sum the position of the next such triple
+    std::vector<size_t> counts(threads * 256);
+    auto chunk = [&](unsigned t) {
+        return std::make_pair(n * t / threads, n * (t + 1) / threads);
+    };
+
+    for (auto key : { minor, middle, major }) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            std::fill(counts.begin(), counts.end(), 0);
+            parallel(threads, [&](unsigned t) {
+                auto [first, last] = chunk(t);
+                auto c = &counts[t * 256];
+                for (size_t i = first; i < last; ++i) {
+                    ++c[(triples[i].*key >> shift) & 255];
+                }
+            });
+
+            // a byte that is equal everywhere does not change the order,
+            // high bytes of small ids usually are
+            size_t sum = 0;
+            bool constant = false;
+            for (int b = 0; b < 256; ++b) {
+                size_t total = 0;
+                for (unsigned t = 0; t < threads; ++t) {
+                    auto c = counts[t * 256 + b];
+                    counts[t * 256 + b] = sum;
+                    sum += c;
+                    total += c;
+                }
+                constant |= total == n;
+            }
+            if (constant) continue;
+
+            parallel(threads, [&](unsigned t) {
+                auto [first, last] = chunk(t);
+                auto c = &counts[t * 256];
+                for (size_t i = first; i < last; ++i) {
+                    tmp[c[(triples[i].*key >> shift) & 255]++] = triples[i];
+                }
+            });
+            triples.swap(tmp);
+        }
+    }
+}
+
+CsrRange CsrGraph::edges(TermId node, uint32_t predicate) const {
+    return predicateRange(edges(node), predicate);
+}
+
+CsrRange CsrGraph::reverseEdges(TermId node, uint32_t predicate) const {
+    return predicateRange(reverseEdges(node), predicate);
+}
+
+size_t CsrGraph::termCount() const {
+    return forwardOffsets.size() - 1;
+}
+
+size_t CsrGraph::edgeCount() const {
+    return forward.size();
+}
+
+size_t CsrGraph::memoryUsage() const {
+    return (forwardOffsets.capacity() + reverseOffsets.capacity()) * sizeof(size_t) +
+           (forward.capacity() + reverse.capacity()) * sizeof(CsrEdge) +
+           nodes.capacity() * sizeof(uint64_t) +
+           predicates.capacity() * sizeof(TermId);
+}
+
+uint32_t CsrGraph::predicateIndex(TermId predicate) const {
+    auto it = std::lower_bound(predicates.begin(), predicates.end(), predicate);
+    if (it == predicates.end() || *it != predicate) {
+        return predicates.size();
+    }
+    return it - predicates.begin();
+}
+
+TermId CsrGraph::predicate(uint32_t index) const {
+    return predicates[index];
+}
+
+uint32_t CsrGraph::predicateCount() const {
+    return predicates.size();
+}
+
+PackedAdjacency::PackedAdjacency(const CsrGraph &graph, bool reverse) :
+    offsets(graph.termCount() + 1, 0) {
+
+    for (TermId v = 0; v < graph.termCount(); ++v) {
+        auto edges = reverse ? graph.reverseEdges(v) : graph.edges(v);
+        uint32_t predicate = 0;
+        for (auto e = edges.begin(); e != edges.end(); ) {
+            auto run = e;
+            while (run != edges.end() && run->predicate == e->predicate) ++run;
+
+            write(bytes, e->predicate - predicate);
+            write(bytes, run - e);
+            predicate = e->predicate;
+
+            TermId target = 0;
+            for (; e != run; ++e) {
+                write(bytes, e->target - target);
+                target = e->target;
+            }
+        }
+        offsets[v + 1] = bytes.size();
+    }
+    bytes.shrink_to_fit();
+}
+
+void PackedAdjacency::write(std::vector<uint8_t> &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+size_t PackedAdjacency::termCount() const {
+    return offsets.size() - 1;
+}
+
+size_t PackedAdjacency::memoryUsage() const {
+    return offsets.capacity() * sizeof(size_t) + bytes.capacity();
+}
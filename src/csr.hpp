@@ -0,0 +1,128 @@
+#pragma once
+
+#include "graph.hpp"
+#include <vector>
+
+// edge of a node, predicate is a dense predicate index and target the
+// node at the other end
+struct CsrEdge {
+    uint32_t predicate;
+    TermId target;
+};
+
+struct CsrRange {
+    const CsrEdge *first = nullptr, *last = nullptr;
+
+    const CsrEdge *begin() const { return first; }
+    const CsrEdge *end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+/* Immutable adjacency of an id graph in compressed sparse row form.
+ *
+ * Nodes are 32-bit term ids. The out-edges and the in-edges of every
+ * node are stored contiguously and ordered by predicate, then target,
+ * so the neighbours over one predicate are a single span. Predicates
+ * are renumbered densely in term id order, so automata over them keep
+ * small alphabets. Duplicate triples are stored once.
+ *
+ * Unsorted input is ordered with a parallel LSD radix sort.
+ */
+class CsrGraph {
+public:
+    // spo must be sorted in SPO order and only use ids below terms
+    CsrGraph(size_t terms, IdRange spo, unsigned threads = 0);
+    explicit CsrGraph(const DictionaryGraph &graph, unsigned threads = 0);
+    // any graph, terms are interned into the given dictionary
+    CsrGraph(const Graph &graph, TermDictionary &terms, unsigned threads = 0);
+
+    CsrRange edges(TermId node) const {
+        return { forward.data() + forwardOffsets[node], forward.data() + forwardOffsets[node + 1] };
+    }
+
+    CsrRange reverseEdges(TermId node) const {
+        return { reverse.data() + reverseOffsets[node], reverse.data() + reverseOffsets[node + 1] };
+    }
+
+    // edges of node over a single predicate
+    CsrRange edges(TermId node, uint32_t predicate) const;
+    CsrRange reverseEdges(TermId node, uint32_t predicate) const;
+
+    // true if the term occurs as a subject or an object
+    bool hasNode(TermId node) const {
+        return (nodes[node >> 6] >> (node & 63)) & 1;
+    }
+
+    // number of term ids, not all of them have to be nodes
+    size_t termCount() const;
+    size_t edgeCount() const;
+    size_t memoryUsage() const;
+
+    // dense index of a predicate term, or predicateCount() if the term
+    // is not used as a predicate
+    uint32_t predicateIndex(TermId predicate) const;
+    TermId predicate(uint32_t index) const;
+    uint32_t predicateCount() const;
+
+    // sorts triples by the components given most significant first
+    static void radixSort(std::vector<IdTriple> &triples, TermId IdTriple::*major,
+                          TermId IdTriple::*middle, TermId IdTriple::*minor, unsigned threads = 0);
+
+private:
+    void build(size_t terms, std::vector<IdTriple> &triples, bool sorted, unsigned threads);
+
+    std::vector<size_t> forwardOffsets, reverseOffsets;
+    std::vector<CsrEdge> forward, reverse;
+    std::vector<uint64_t> nodes;
+    // predicate terms, ascending
+    std::vector<TermId> predicates;
+};
+
+/* Delta-encoded copy of one direction of a CsrGraph.
+ *
+ * The edges of a node are stored as one run per predicate: the
+ * predicate as a difference to the previous run, the run length and
+ * the targets as differences to the previous target, all as LEB128
+ * varints. Sorted neighbour lists have small gaps, so most edges take
+ * one or two bytes instead of eight.
+ */
+class PackedAdjacency {
+public:
+    explicit PackedAdjacency(const CsrGraph &graph, bool reverse = false);
+
+    // calls fn(predicate, target) for every edge of node, in CSR order
+    template <typename F>
+    void forEach(TermId node, F &&fn) const {
+        const uint8_t *p = bytes.data() + offsets[node];
+        const uint8_t *end = bytes.data() + offsets[node + 1];
+        uint32_t predicate = 0;
+        while (p != end) {
+            predicate += read(p);
+            uint32_t count = read(p);
+            TermId target = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                target += read(p);
+                fn(predicate, target);
+            }
+        }
+    }
+
+    size_t termCount() const;
+    size_t memoryUsage() const;
+
+private:
+    static uint32_t read(const uint8_t *&p) {
+        uint32_t res = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t b = *p++;
+            res |= uint32_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) return res;
+        }
+    }
+
+    static void write(std::vector<uint8_t> &out, uint32_t value);
+
+    std::vector<size_t> offsets;
+    std::vector<uint8_t> bytes;
+};
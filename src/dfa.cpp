@@ -1,25 +1,7 @@
 #include "automaton.hpp"
 #include <sstream>
 #include <algorithm>
-#include <set>
-#include <functional>
-
-DFA::DFA(const DFA& that) {
-    std::map<Node*, int> indexes;
-    for (auto &node : that.nodes) {
-        indexes[node.get()] = indexes.size();
-        auto t = std::make_unique<Node>();
-        t->term = node->term;
-        nodes.emplace_back(std::move(t));
-    }
-
-    for (auto &node : that.nodes) {
-        auto &t = nodes[indexes[node.get()]];
-        for (auto &[ch, to] : node->trans) {
-            t->trans[ch] = nodes[indexes[to]].get();
-        }
-    }
-}
+#include <unordered_map>
 
 DFA &DFA::operator=(DFA that) {
     swap(that);
@@ -27,189 +9,379 @@ DFA &DFA::operator=(DFA that) {
 }
 
 void DFA::swap(DFA &that) {
-    nodes.swap(that.nodes);
+    states.swap(that.states);
+    trans.swap(that.trans);
+    std::swap(unused, that.unused);
 }
 
-DFA DFA::fromRegex(const std::string &str) {
-    return NFA::fromRegex(str).determinize();
+int DFA::addState(bool term) {
+    int32_t end = trans.size();
+    states.push_back({ end, end, term });
+    return states.size() - 1;
 }
 
-void DFA::intersect(DFA that) {
-    std::map<Node*, int> thisIdx, thatIdx;
-    auto thisNodes = std::move(nodes);
-    nodes.clear();
+void DFA::addTransition(int from, int symbol, int to) {
+    if (states[from].last != int32_t(trans.size())) {
+        // only the run at the end of the arena can grow, so this one
+        // moves there; the arena is compacted once half of it is unused
+        if (unused > trans.size() / 2) {
+            std::vector<int> index(states.size());
+            for (size_t v = 0; v < index.size(); ++v) {
+                index[v] = v;
+            }
+            renumber(index);
+        }
 
-    for (auto &node : thisNodes) {
-        thisIdx[node.get()] = thisIdx.size();
+        auto &state = states[from];
+        if (state.last != int32_t(trans.size())) {
+            int32_t count = state.last - state.first;
+            trans.reserve(trans.size() + count + 1);
+            for (int32_t i = state.first; i < state.last; ++i) {
+                trans.push_back(trans[i]);
+            }
+            unused += count;
+            state.last = trans.size();
+            state.first = state.last - count;
+        }
     }
 
-    for (auto &node : that.nodes) {
-        thatIdx[node.get()] = thatIdx.size();
+    auto &state = states[from];
+    auto it = std::lower_bound(trans.begin() + state.first, trans.end(), symbol,
+                               [](const Transition &t, int symbol) { return t.symbol < symbol; });
+    if (it != trans.end() && it->symbol == symbol) {
+        it->to = to;
+        return;
     }
+    trans.insert(it, { symbol, to });
+    ++state.last;
+}
 
-    for (int i = 0; i < thisNodes.size(); ++i) {
-        for (int j = 0; j < that.nodes.size(); ++j) {
-            auto node = std::make_unique<Node>();
-            node->term = thisNodes[i]->term && that.nodes[j]->term;
-            nodes.emplace_back(std::move(node));
+int DFA::next(int state, int symbol) const {
+    auto run = transitions(state);
+    if (run.last - run.first <= 8) {
+        for (auto &t : run) {
+            if (t.symbol == symbol) {
+                return t.to;
+            }
         }
+        return -1;
     }
 
-    for (int i = 0; i < thisNodes.size(); ++i) {
-        auto &ti = thisNodes[i]->trans;
-        for (int j = 0; j < that.nodes.size(); ++j) {
-            int idx = i * that.nodes.size() + j;
-            auto &tj = that.nodes[j]->trans;
+    auto it = std::lower_bound(run.first, run.last, symbol,
+                               [](const Transition &t, int symbol) { return t.symbol < symbol; });
+    return it != run.last && it->symbol == symbol ? it->to : -1;
+}
+
+void DFA::renumber(const std::vector<int> &index) {
+    std::vector<State> newStates;
+    std::vector<Transition> newTrans;
+    newTrans.reserve(trans.size() - unused);
+
+    for (size_t v = 0; v < states.size(); ++v) {
+        // dropped, or merged into an earlier state
+        if (index[v] != int(newStates.size())) continue;
 
-            for (auto &[ch, to] : ti) {
-                if (tj.find(ch) == tj.end()) continue;
-                int u = thisIdx[to];
-                int v = thatIdx[tj[ch]];
-                int tidx = u * that.nodes.size() + v;
-                nodes[idx]->trans[ch] = nodes[tidx].get();
+        State state{ int32_t(newTrans.size()), 0, states[v].term };
+        for (auto &t : transitions(v)) {
+            if (index[t.to] != -1) {
+                newTrans.push_back({ t.symbol, index[t.to] });
             }
         }
+        state.last = newTrans.size();
+        newStates.push_back(state);
     }
 
+    states.swap(newStates);
+    trans.swap(newTrans);
+    unused = 0;
+}
+
+DFA DFA::fromRegex(const std::string &str) {
+    return NFA::fromRegex(str).determinize();
+}
+
+DFA DFA::fromRegex(const std::string &str, const SymbolResolver &resolve) {
+    return NFA::fromRegex(str, resolve).determinize();
+}
+
+std::shared_ptr<const DFA> DFA::fromRegex(const std::string &str, DFACache &cache) {
+    return cache.get(str);
+}
+
+void DFA::intersect(DFA that) {
+    *this = product(*this, that, nullptr);
     minimize();
 }
 
+bool DFA::intersects(const DFA &that) const {
+    bool found = false;
+    product(*this, that, &found);
+    return found;
+}
+
+DFA DFA::product(const DFA &a, const DFA &b, bool *found) {
+    // Explore only pairs reachable from the pair of start states.
+    // Only symbols both automata use matter, and among those
+    // it suffices to look at one symbol per joint class.
+    auto alphabet = SymbolClasses::intersect(a.symbolClasses(), b.symbolClasses());
+
+    DFA res;
+    std::unordered_map<uint64_t, int> pairs;
+    std::vector<std::pair<int, int>> queue;
+
+    auto visit = [&](int u, int v) {
+        uint64_t key = uint64_t(u) << 32 | v;
+        auto [it, inserted] = pairs.emplace(key, res.states.size());
+        if (inserted) {
+            res.addState(a.states[u].term && b.states[v].term);
+            queue.emplace_back(u, v);
+        }
+        return it->second;
+    };
+
+    visit(0, 0);
+
+    for (size_t i = 0; i < queue.size(); ++i) {
+        auto [u, v] = queue[i];
+        if (found && res.states[i].term) {
+            *found = true;
+            break;
+        }
+
+        for (auto &t : a.transitions(u)) {
+            int c = alphabet.classOf(t.symbol);
+            if (c == 0 || alphabet.representative(c) != t.symbol) continue;
+            int w = b.next(v, t.symbol);
+            if (w == -1) continue;
+
+            int target = visit(t.to, w);
+            for (int symbol : alphabet.members(c)) {
+                res.addTransition(i, symbol, target);
+            }
+        }
+    }
+
+    return res;
+}
+
 void DFA::stripUnreachable() {
-    std::set<Node*> used;
-    std::function<void(Node*)> dfs = [&](Node *v) {
-        used.insert(v);
-        for (auto &[ch, to] : v->trans) {
-            if (used.find(to) == used.end()) {
-                dfs(to);
+    std::vector<int> index(states.size(), -1);
+    std::vector<int> stack{0};
+    index[0] = 0;
+
+    while (!stack.empty()) {
+        int v = stack.back();
+        stack.pop_back();
+        for (auto &t : transitions(v)) {
+            if (index[t.to] == -1) {
+                index[t.to] = 0;
+                stack.push_back(t.to);
             }
         }
-    };
+    }
 
-    dfs(nodes[0].get());
-    for (int i = 0; i < nodes.size();) {
-        if (used.find(nodes[i].get()) == used.end()) {
-            std::swap(nodes[i], nodes.back());
-            nodes.pop_back();
-        } else {
-            ++i;
+    // keep relative order, the start state stays first
+    int count = 0;
+    for (auto &i : index) {
+        if (i != -1) {
+            i = count++;
         }
     }
+    renumber(index);
 }
 
-void DFA::minimize() {
-    // https://en.wikipedia.org/wiki/DFA_minimization#Hopcroft's_algorithm
+namespace {
 
-    stripUnreachable();
+/* Refinable partition of the states 0..n-1 (Valmari & Lehtinen).
+ * Each block is a contiguous range of elems, states of a block that
+ * were marked since the last split are moved to the front of its range.
+ */
+struct Partition {
+    std::vector<int> elems, loc, blockOf;
+    std::vector<int> first, end, mid;
 
-    std::map<Node*, int> indexes;
-    std::vector<std::set<int>> p(2);
-    for (auto &node : nodes) {
-        int idx = indexes[node.get()] = indexes.size();
-        if (node->term) {
-            p[0].insert(idx);
-        } else {
-            p[1].insert(idx);
+    explicit Partition(int n) : elems(n), loc(n), blockOf(n, 0), first{0}, end{n}, mid{0} {
+        for (int i = 0; i < n; ++i) {
+            elems[i] = loc[i] = i;
         }
     }
 
-    auto w = p;
+    int blocks() const {
+        return first.size();
+    }
 
-    while (!w.empty()) {
-        auto a = w.back();
-        w.pop_back();
-        if (a.empty()) continue;
+    int size(int b) const {
+        return end[b] - first[b];
+    }
 
-        std::map<int, std::set<int>> xs;
+    // returns true if this is the first mark in the block
+    bool mark(int s) {
+        int b = blockOf[s];
+        int i = loc[s];
+        if (i < mid[b]) {
+            return false;
+        }
+        int t = elems[mid[b]];
+        std::swap(elems[i], elems[mid[b]]);
+        loc[t] = i;
+        loc[s] = mid[b]++;
+        return mid[b] - 1 == first[b];
+    }
 
-        for (auto &node : nodes) {
-            for (auto &[ch, to] : node->trans) {
-                auto idx = indexes[to];
-                if (a.find(idx) != a.end()) {
-                    xs[ch].insert(indexes[node.get()]);
-                }
-            }
+    // splits marked states off block b, returns the new block or -1
+    int split(int b) {
+        if (mid[b] == end[b]) {
+            mid[b] = first[b];
+            return -1;
         }
 
-        for (auto &[ch, x] : xs) {
-            for (int j = 0; j < p.size();) {
-                auto &y = p[j];
-                std::set<int> s1, s2;
+        int nb = blocks();
+        first.push_back(first[b]);
+        end.push_back(mid[b]);
+        mid.push_back(first[b]);
+        first[b] = mid[b];
 
-                for (int i : y) {
-                    if (x.find(i) != x.end()) {
-                        s1.insert(i);
-                    } else {
-                        s2.insert(i);
-                    }
-                }
+        for (int i = first[nb]; i < end[nb]; ++i) {
+            blockOf[elems[i]] = nb;
+        }
+        return nb;
+    }
+};
 
-                if (s1.empty() || s2.empty()) {
-                    ++j;
-                    continue;
-                }
+} // namespace
 
-                auto wit = std::find(w.begin(), w.end(), y);
+void DFA::minimize() {
+    // Hopcroft's algorithm on a complete automaton: missing transitions
+    // go to an extra dead state, symbols are grouped into symbol classes.
+    // Runs in O(n * classes * log n) thanks to precomputed inverse
+    // transitions and the "process the smaller half" rule.
 
-                p.push_back(s1);
-                p.push_back(s2);
+    stripUnreachable();
 
-                if (wit != w.end()) {
-                    w.erase(wit);
-                    w.push_back(s1);
-                    w.push_back(s2);
-                } else {
-                    if (s1.size() <= s2.size()) {
-                        w.push_back(s1);
-                    } else {
-                        w.push_back(s2);
-                    }
-                }
+    auto alphabet = symbolClasses();
+    int n = states.size() + 1;
+    int dead = n - 1;
+    int k = alphabet.count() - 1;
 
-                p.erase(p.begin() + j);
-            }
+    // delta[v * k + c - 1] is the target of state v on class c
+    std::vector<int> delta(size_t(n) * k, dead);
+    for (int v = 0; v < n - 1; ++v) {
+        for (auto &t : transitions(v)) {
+            delta[size_t(v) * k + alphabet.classOf(t.symbol) - 1] = t.to;
         }
     }
 
-    std::vector<int> equiv(nodes.size());
-    for (auto &s : p) {
-        if (s.empty()) continue;
-        for (int i : s) {
-            equiv[i] = *s.begin();
+    // inverse transitions grouped by (target, class)
+    std::vector<int> invStart(size_t(n) * k + 1, 0), inv(delta.size());
+    for (size_t e = 0; e < delta.size(); ++e) {
+        ++invStart[size_t(delta[e]) * k + e % k + 1];
+    }
+    for (size_t i = 1; i < invStart.size(); ++i) {
+        invStart[i] += invStart[i - 1];
+    }
+    {
+        auto pos = invStart;
+        for (size_t e = 0; e < delta.size(); ++e) {
+            inv[pos[size_t(delta[e]) * k + e % k]++] = e / k;
         }
     }
 
-    for (auto &node : nodes) {
-        for (auto &[ch, to] : node->trans) {
-            to = nodes[equiv[indexes[to]]].get();
+    Partition p{n};
+    for (int v = 0; v < n - 1; ++v) {
+        if (states[v].term) {
+            p.mark(v);
         }
     }
 
-    std::vector<std::unique_ptr<Node>> newNodes;
+    std::vector<int> w;
+    std::vector<char> inW;
+    auto addToW = [&](int b) {
+        inW.resize(p.blocks());
+        if (!inW[b]) {
+            inW[b] = 1;
+            w.push_back(b);
+        }
+    };
+
+    if (p.mid[0] > p.first[0]) {
+        int accepting = p.split(0);
+        addToW(p.size(accepting) <= p.size(0) ? accepting : 0);
+    }
+
+    std::vector<int> splitter, touched;
+    while (!w.empty()) {
+        int a = w.back();
+        w.pop_back();
+        inW[a] = 0;
+        splitter.assign(p.elems.begin() + p.first[a], p.elems.begin() + p.end[a]);
+
+        for (int c = 0; c < k; ++c) {
+            for (int t : splitter) {
+                auto from = inv.begin() + invStart[size_t(t) * k + c];
+                auto to = inv.begin() + invStart[size_t(t) * k + c + 1];
+                for (auto it = from; it != to; ++it) {
+                    if (p.mark(*it)) {
+                        touched.push_back(p.blockOf[*it]);
+                    }
+                }
+            }
+
+            for (int y : touched) {
+                int z = p.split(y);
+                if (z == -1) continue;
+                inW.resize(p.blocks());
+                if (inW[y]) {
+                    addToW(z);
+                } else {
+                    addToW(p.size(z) <= p.size(y) ? z : y);
+                }
+            }
+            touched.clear();
+        }
+    }
 
-    for (int i = 0; i < nodes.size(); ++i) {
-        if (equiv[i] != i) continue;
-        newNodes.emplace_back(std::move(nodes[i]));
+    // blocks equivalent to the dead state cannot reach acceptance,
+    // drop them together with all transitions leading there
+    int deadBlock = p.blockOf[dead];
+    if (p.blockOf[0] == deadBlock) {
+        states.assign(1, State{});
+        trans.clear();
+        unused = 0;
+        return;
     }
 
-    nodes = std::move(newNodes);
+    // the smallest state of each block represents it; state 0 stays first
+    std::vector<int> id(p.blocks(), -1), index(n - 1);
+    int count = 0;
+    for (int v = 0; v < n - 1; ++v) {
+        int b = p.blockOf[v];
+        if (b == deadBlock) {
+            index[v] = -1;
+            continue;
+        }
+        if (id[b] == -1) {
+            id[b] = count++;
+        }
+        index[v] = id[b];
+    }
+    renumber(index);
 }
 
 bool DFA::accepts(const std::string &s) const {
-    auto state = nodes[0].get();
+    int state = 0;
 
     for (char c : s) {
-        if (state->trans.find(c) != state->trans.end()) {
-            state = state->trans[c];
-        } else {
+        state = next(state, c);
+        if (state == -1) {
             return false;
         }
     }
 
-    return state->term;
+    return states[state].term;
 }
 
 int DFA::size() const {
-    return nodes.size();
+    return states.size();
 }
 
 std::ostream &operator<<(std::ostream &os, const DFA &dfa) {
@@ -217,31 +389,27 @@ std::ostream &operator<<(std::ostream &os, const DFA &dfa) {
 
     os << "digraph DFA {" << std::endl;
 
-    std::map<DFA::Node*, int> indexes;
     bool f = false;
-    for (auto &node : dfa.nodes) {
-        indexes[node.get()] = indexes.size();
-        if (node->term) {
+    for (auto &state : dfa.states) {
+        if (state.term) {
             f = true;
         }
     }
     if (f) {
         os << "node [shape = doublecircle];";
-        for (auto &node : dfa.nodes) {
-            if (node->term) {
-                os << " " << indexes[node.get()];
+        for (int v = 0; v < dfa.size(); ++v) {
+            if (dfa.states[v].term) {
+                os << " " << v;
             }
         }
         os << ";" << std::endl;
     }
     os << "node [shape = circle];" << std::endl;
 
-    for (auto &node : dfa.nodes) {
-        int fromIdx = indexes[node.get()];
-        for (auto [ch, to] : node->trans) {
-            int toIdx = indexes[to];
-            os << fromIdx << " -> " << toIdx;
-            std::string label{(char)ch};
+    for (int v = 0; v < dfa.size(); ++v) {
+        for (auto &t : dfa.transitions(v)) {
+            os << v << " -> " << t.to;
+            std::string label{(char)t.symbol};
             os << " [label = \"" << label << "\" ];" << std::endl;
         }
     }
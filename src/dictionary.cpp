@@ -0,0 +1,108 @@
+#include "dictionary.hpp"
+
+namespace {
+
+size_t probeSlots(const TermDictionaryView &dict, std::string_view term, uint64_t h) {
+    size_t mask = dict.slotCount - 1;
+    size_t i = h & mask;
+    while (dict.slots[i] != TermDictionaryView::NoTerm && dict.term(dict.slots[i]) != term) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+} // namespace
+
+TermDictionaryView::TermDictionaryView(const char *pool, const uint64_t *offsets, size_t count,
+                                       const TermId *slots, size_t slotCount) :
+    pool(pool), offsets(offsets), count(count), slots(slots), slotCount(slotCount) {}
+
+uint64_t TermDictionaryView::hash(std::string_view term) {
+    // 64-bit FNV-1a, stable across runs and platforms
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : term) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+TermId TermDictionaryView::find(std::string_view term) const {
+    if (slotCount == 0) {
+        return NoTerm;
+    }
+    return slots[probeSlots(*this, term, hash(term))];
+}
+
+std::string_view TermDictionaryView::term(TermId id) const {
+    return std::string_view{pool + offsets[id], size_t(offsets[id + 1] - offsets[id])};
+}
+
+size_t TermDictionaryView::size() const {
+    return count;
+}
+
+TermDictionary::TermDictionary() : offsets{0}, slots(16, NoTerm) {}
+
+uint64_t TermDictionary::hash(std::string_view term) {
+    return TermDictionaryView::hash(term);
+}
+
+size_t TermDictionary::probe(std::string_view term, uint64_t h) const {
+    return probeSlots(view(), term, h);
+}
+
+void TermDictionary::rehash(size_t capacity) {
+    slots.assign(capacity, NoTerm);
+    size_t mask = capacity - 1;
+    for (TermId id = 0; id < size(); ++id) {
+        size_t i = hash(term(id)) & mask;
+        while (slots[i] != NoTerm) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = id;
+    }
+}
+
+TermId TermDictionary::intern(std::string_view term) {
+    uint64_t h = hash(term);
+    size_t i = probe(term, h);
+    if (slots[i] != NoTerm) {
+        return slots[i];
+    }
+
+    TermId id = size();
+    pool.append(term);
+    offsets.push_back(pool.size());
+
+    // keep load factor below 1/2
+    if (2 * size() > slots.size()) {
+        rehash(2 * slots.size());
+    } else {
+        slots[i] = id;
+    }
+
+    return id;
+}
+
+TermId TermDictionary::find(std::string_view term) const {
+    return slots[probe(term, hash(term))];
+}
+
+std::string_view TermDictionary::term(TermId id) const {
+    return view().term(id);
+}
+
+size_t TermDictionary::size() const {
+    return offsets.size() - 1;
+}
+
+size_t TermDictionary::memoryUsage() const {
+    return pool.capacity() +
+           offsets.capacity() * sizeof(offsets[0]) +
+           slots.capacity() * sizeof(slots[0]);
+}
+
+TermDictionaryView TermDictionary::view() const {
+    return TermDictionaryView{pool.data(), offsets.data(), size(), slots.data(), slots.size()};
+}
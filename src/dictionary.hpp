@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using TermId = uint32_t;
+
+/* Read-only term dictionary over externally owned arrays,
+ * e.g. the sections of a mapped snapshot file.
+ */
+class TermDictionaryView {
+public:
+    static constexpr TermId NoTerm = ~TermId(0);
+
+    TermDictionaryView() = default;
+    TermDictionaryView(const char *pool, const uint64_t *offsets, size_t count,
+                       const TermId *slots, size_t slotCount);
+
+    TermId find(std::string_view term) const;
+    std::string_view term(TermId id) const;
+    size_t size() const;
+
+    static uint64_t hash(std::string_view term);
+
+    // term i occupies pool[offsets[i], offsets[i + 1])
+    const char *pool = nullptr;
+    const uint64_t *offsets = nullptr;
+    size_t count = 0;
+    // open addressing with linear probing, NoTerm marks an empty slot,
+    // slotCount is a power of two
+    const TermId *slots = nullptr;
+    size_t slotCount = 0;
+};
+
+/* Bidirectional mapping between RDF terms and dense integer ids.
+ *
+ * Term bytes are stored back to back in a single pool, id -> term is an
+ * offset lookup and term -> id goes through an open-addressing table of
+ * ids, so interning a term costs no allocation besides amortized growth.
+ */
+class TermDictionary {
+public:
+    static constexpr TermId NoTerm = TermDictionaryView::NoTerm;
+
+    TermDictionary();
+
+    TermId intern(std::string_view term);
+    TermId find(std::string_view term) const;
+    std::string_view term(TermId id) const;
+    size_t size() const;
+    size_t memoryUsage() const;
+
+    // invalidated by the next intern
+    TermDictionaryView view() const;
+
+    static uint64_t hash(std::string_view term);
+
+private:
+    size_t probe(std::string_view term, uint64_t h) const;
+    void rehash(size_t capacity);
+
+    std::string pool;
+    std::vector<uint64_t> offsets;
+    std::vector<TermId> slots;
+};
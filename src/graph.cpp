@@ -1,6 +1,99 @@
 #include "graph.hpp"
 #include <algorithm>
 
+namespace {
+
+class ListCursor : public TripleCursor {
+public:
+    ListCursor(const std::vector<Triple> &triples, const TriplePattern &pattern) :
+        it(triples.cbegin()), end(triples.cend()), pattern(pattern) {}
+
+    bool next(Triple &triple) override {
+        for (; it != end; ++it) {
+            if (pattern.matches(*it)) {
+                triple = *it++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<Triple>::const_iterator it, end;
+    TriplePattern pattern;
+};
+
+} // namespace
+
+IdRangeCursor::IdRangeCursor(TermDictionaryView terms, IdRange range) :
+    terms(terms), range(range) {}
+
+bool IdRangeCursor::next(Triple &triple) {
+    if (range.empty()) {
+        return false;
+    }
+    auto &t = *range.first++;
+    triple.subject = terms.term(t.subject);
+    triple.predicate = terms.term(t.predicate);
+    triple.object = terms.term(t.object);
+    return true;
+}
+
+void TripleBuffer::add(std::string_view subject, std::string_view predicate, std::string_view object) {
+    triples.push_back(IdTriple {
+        terms.intern(subject),
+        terms.intern(predicate),
+        terms.intern(object)
+    });
+}
+
+void TripleBuffer::clear() {
+    terms = TermDictionary{};
+    triples.clear();
+}
+
+void Graph::addTriples(const TripleBuffer &buffer) {
+    auto &terms = buffer.terms;
+    for (auto &t : buffer.triples) {
+        addTriple(Triple {
+            Triple::Locator{terms.term(t.subject)},
+            Triple::Locator{terms.term(t.predicate)},
+            Triple::Locator{terms.term(t.object)}
+        });
+    }
+}
+
+void Graph::addStatement(std::string_view subject, std::string_view predicate, std::string_view object) {
+    addTriple(Triple {
+        Triple::Locator{subject},
+        Triple::Locator{predicate},
+        Triple::Locator{object}
+    });
+}
+
+bool TriplePattern::matches(const Triple &triple) const {
+    return (!subject || *subject == triple.subject) &&
+           (!predicate || *predicate == triple.predicate) &&
+           (!object || *object == triple.object);
+}
+
+bool TriplePattern::encode(const TermDictionaryView &terms, IdTriple &pattern) const {
+    bool known = true;
+    auto find = [&](const std::optional<Triple::Locator> &term) {
+        if (!term) {
+            return TermDictionary::NoTerm;
+        }
+        auto id = terms.find(*term);
+        known = known && id != TermDictionary::NoTerm;
+        return id;
+    };
+
+    pattern.subject = find(subject);
+    pattern.predicate = find(predicate);
+    pattern.object = find(object);
+    return known;
+}
+
 void TripleListGraph::addTriple(const Triple &triple) {
     triples.push_back(triple);
 }
@@ -8,3 +101,102 @@ void TripleListGraph::addTriple(const Triple &triple) {
 bool TripleListGraph::hasTriple(const Triple &triple) const {
     return std::find(triples.cbegin(), triples.cend(), triple) != triples.cend();
 }
+
+std::unique_ptr<TripleCursor> TripleListGraph::match(const TriplePattern &pattern) const {
+    return std::make_unique<ListCursor>(triples, pattern);
+}
+
+void DictionaryGraph::addTriple(const Triple &triple) {
+    addStatement(triple.subject, triple.predicate, triple.object);
+}
+
+void DictionaryGraph::addStatement(std::string_view subject, std::string_view predicate, std::string_view object) {
+    insert(IdTriple {
+        dictionary.intern(subject),
+        dictionary.intern(predicate),
+        dictionary.intern(object)
+    });
+}
+
+void DictionaryGraph::addTriples(const TripleBuffer &buffer) {
+    // intern each distinct term of the buffer once, then remap ids
+    std::vector<TermId> remap(buffer.terms.size());
+    for (TermId id = 0; id < remap.size(); ++id) {
+        remap[id] = dictionary.intern(buffer.terms.term(id));
+    }
+
+    for (auto &t : buffer.triples) {
+        insert(IdTriple {
+            remap[t.subject],
+            remap[t.predicate],
+            remap[t.object]
+        });
+    }
+}
+
+void DictionaryGraph::insert(const IdTriple &t) {
+    if (unique.insert(t)) {
+        encoded.push_back(t);
+    }
+}
+
+bool DictionaryGraph::hasTriple(const Triple &triple) const {
+    IdTriple t;
+    if (!encode(triple, t)) {
+        return false;
+    }
+    return unique.contains(t);
+}
+
+std::unique_ptr<TripleCursor> DictionaryGraph::match(const TriplePattern &pattern) const {
+    IdTriple t;
+    if (!pattern.encode(dictionary.view(), t)) {
+        return std::make_unique<IdRangeCursor>(dictionary.view(), IdRange{});
+    }
+    return std::make_unique<IdRangeCursor>(dictionary.view(), matchIds(t));
+}
+
+IdRange DictionaryGraph::matchIds(const IdTriple &pattern) const {
+    return index().match(pattern);
+}
+
+bool DictionaryGraph::encode(const Triple &triple, IdTriple &t) const {
+    t.subject = dictionary.find(triple.subject);
+    t.predicate = dictionary.find(triple.predicate);
+    t.object = dictionary.find(triple.object);
+    return t.subject != TermDictionary::NoTerm &&
+           t.predicate != TermDictionary::NoTerm &&
+           t.object != TermDictionary::NoTerm;
+}
+
+Triple DictionaryGraph::decode(const IdTriple &t) const {
+    return Triple {
+        Triple::Locator{dictionary.term(t.subject)},
+        Triple::Locator{dictionary.term(t.predicate)},
+        Triple::Locator{dictionary.term(t.object)}
+    };
+}
+
+const TermDictionary &DictionaryGraph::terms() const {
+    return dictionary;
+}
+
+const std::vector<IdTriple> &DictionaryGraph::triples() const {
+    return encoded;
+}
+
+const TripleIndex &DictionaryGraph::index() const {
+    indexes.update(encoded);
+    return indexes;
+}
+
+size_t DictionaryGraph::size() const {
+    return encoded.size();
+}
+
+size_t DictionaryGraph::memoryUsage() const {
+    return dictionary.memoryUsage() +
+           encoded.capacity() * sizeof(IdTriple) +
+           unique.memoryUsage() +
+           3 * indexes.size() * sizeof(IdTriple);
+}
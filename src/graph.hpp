@@ -1,6 +1,11 @@
 #pragma once
 
+#include "dictionary.hpp"
+#include "index.hpp"
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct Triple {
@@ -15,16 +20,108 @@ struct Triple {
     }
 };
 
+// triple with optional components, missing ones match anything
+struct TriplePattern {
+    std::optional<Triple::Locator> subject, predicate, object;
+
+    bool matches(const Triple &triple) const;
+
+    // free components become NoTerm wildcards,
+    // returns false if a bound term is unknown to the dictionary
+    bool encode(const TermDictionaryView &terms, IdTriple &pattern) const;
+};
+
+// batch of triples encoded against its own private dictionary
+struct TripleBuffer {
+    TermDictionary terms;
+    std::vector<IdTriple> triples;
+
+    void add(std::string_view subject, std::string_view predicate, std::string_view object);
+    void clear();
+};
+
+class TripleCursor {
+public:
+    virtual ~TripleCursor() = default;
+
+    // stores the next matching triple, returns false when exhausted
+    virtual bool next(Triple &triple) = 0;
+};
+
+// decodes a range of id triples against a dictionary
+class IdRangeCursor : public TripleCursor {
+public:
+    IdRangeCursor(TermDictionaryView terms, IdRange range);
+
+    bool next(Triple &triple) override;
+
+private:
+    TermDictionaryView terms;
+    IdRange range;
+};
+
 class Graph {
 public:
+    virtual ~Graph() = default;
+
     virtual void addTriple(const Triple &triple) = 0;
     virtual bool hasTriple(const Triple &triple) const = 0;
+    virtual std::unique_ptr<TripleCursor> match(const TriplePattern &pattern) const = 0;
+
+    // adds every triple of the buffer, in order
+    virtual void addTriples(const TripleBuffer &buffer);
+
+    // ingest path for parsers, terms are only valid during the call
+    virtual void addStatement(std::string_view subject, std::string_view predicate, std::string_view object);
 };
 
 class TripleListGraph : public Graph {
 public:
     void addTriple(const Triple &triple) override;
     bool hasTriple(const Triple &triple) const override;
+    std::unique_ptr<TripleCursor> match(const TriplePattern &pattern) const override;
 
     std::vector<Triple> triples;
 };
+
+/* Triple store that interns every term into a TermDictionary
+ * and keeps triples as tuples of 32-bit term ids.
+ *
+ * The graph is a set: duplicate triples are dropped on insertion
+ * and membership is answered by a hash table in constant time.
+ *
+ * Permutation indexes are brought up to date lazily by the first
+ * query after an insertion, so reads must not race with each other
+ * until the graph has been queried once after the last write.
+ */
+class DictionaryGraph : public Graph {
+public:
+    void addTriple(const Triple &triple) override;
+    bool hasTriple(const Triple &triple) const override;
+    std::unique_ptr<TripleCursor> match(const TriplePattern &pattern) const override;
+    void addTriples(const TripleBuffer &buffer) override;
+    void addStatement(std::string_view subject, std::string_view predicate, std::string_view object) override;
+
+    // TermDictionary::NoTerm components of pattern act as wildcards
+    IdRange matchIds(const IdTriple &pattern) const;
+
+    // returns false if some term of the triple is unknown to the dictionary
+    bool encode(const Triple &triple, IdTriple &encoded) const;
+    Triple decode(const IdTriple &triple) const;
+
+    const TermDictionary &terms() const;
+    const std::vector<IdTriple> &triples() const;
+    const TripleIndex &index() const;
+    size_t size() const;
+    size_t memoryUsage() const;
+
+private:
+    friend class BulkLoader;
+
+    void insert(const IdTriple &triple);
+
+    TermDictionary dictionary;
+    std::vector<IdTriple> encoded;
+    TripleSet unique;
+    mutable TripleIndex indexes;
+};
@@ -0,0 +1,195 @@
+#include "index.hpp"
+#include <algorithm>
+#include <array>
+
+namespace {
+
+using Key = std::array<TermId, 3>;
+
+Key key(IndexOrder order, const IdTriple &t) {
+    switch (order) {
+        case IndexOrder::SPO:
+            return { t.subject, t.predicate, t.object };
+        case IndexOrder::POS:
+            return { t.predicate, t.object, t.subject };
+        case IndexOrder::OSP:
+            return { t.object, t.subject, t.predicate };
+    }
+    return {};
+}
+
+// number of leading bound components of pattern in the given order
+int boundPrefix(const Key &k) {
+    int n = 0;
+    while (n < 3 && k[n] != TermDictionary::NoTerm) {
+        ++n;
+    }
+    return n;
+}
+
+const IdTriple EmptySlot {
+    TermDictionary::NoTerm, TermDictionary::NoTerm, TermDictionary::NoTerm
+};
+
+} // namespace
+
+TripleSet::TripleSet() : slots(16, EmptySlot) {}
+
+uint64_t TripleSet::hash(const IdTriple &t) {
+    // murmur3 finalizer over the packed ids
+    uint64_t h = (uint64_t(t.subject) << 32 | t.predicate) ^
+                 (uint64_t(t.object) * 0x9e3779b97f4a7c15ull);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+size_t TripleSet::probe(const IdTriple &triple) const {
+    size_t mask = slots.size() - 1;
+    size_t i = hash(triple) & mask;
+    while (slots[i].subject != TermDictionary::NoTerm && !(slots[i] == triple)) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void TripleSet::rehash(size_t capacity) {
+    std::vector<IdTriple> old(capacity, EmptySlot);
+    old.swap(slots);
+    for (auto &t : old) {
+        if (t.subject != TermDictionary::NoTerm) {
+            slots[probe(t)] = t;
+        }
+    }
+}
+
+bool TripleSet::insert(const IdTriple &triple) {
+    size_t i = probe(triple);
+    if (slots[i].subject != TermDictionary::NoTerm) {
+        return false;
+    }
+
+    slots[i] = triple;
+    ++count;
+
+    // keep load factor below 3/4
+    if (4 * count > 3 * slots.size()) {
+        rehash(2 * slots.size());
+    }
+    return true;
+}
+
+bool TripleSet::contains(const IdTriple &triple) const {
+    return slots[probe(triple)].subject != TermDictionary::NoTerm;
+}
+
+void TripleSet::reserve(size_t n) {
+    size_t capacity = slots.size();
+    while (4 * n > 3 * capacity) {
+        capacity *= 2;
+    }
+    if (capacity != slots.size()) {
+        rehash(capacity);
+    }
+}
+
+void TripleSet::clear() {
+    slots.assign(16, EmptySlot);
+    count = 0;
+}
+
+size_t TripleSet::size() const {
+    return count;
+}
+
+size_t TripleSet::memoryUsage() const {
+    return slots.capacity() * sizeof(IdTriple);
+}
+
+void TripleIndex::update(const std::vector<IdTriple> &triples) {
+    size_t done = size();
+    if (done == triples.size()) {
+        return;
+    }
+
+    for (auto order : { IndexOrder::SPO, IndexOrder::POS, IndexOrder::OSP }) {
+        auto &v = indexes[static_cast<int>(order)];
+        v.insert(v.end(), triples.begin() + done, triples.end());
+        sort(order, v.data() + done, v.data() + v.size());
+        std::inplace_merge(v.begin(), v.begin() + done, v.end(),
+            [order](const IdTriple &a, const IdTriple &b) {
+                return key(order, a) < key(order, b);
+            });
+    }
+}
+
+void TripleIndex::insertSorted(IndexOrder order, const std::vector<IdTriple> &sorted) {
+    auto &v = indexes[static_cast<int>(order)];
+    size_t done = v.size();
+    v.insert(v.end(), sorted.begin(), sorted.end());
+    std::inplace_merge(v.begin(), v.begin() + done, v.end(),
+        [order](const IdTriple &a, const IdTriple &b) {
+            return key(order, a) < key(order, b);
+        });
+}
+
+void TripleIndex::clear() {
+    for (auto &v : indexes) {
+        v.clear();
+    }
+}
+
+IdRange TripleIndex::match(const IdTriple &pattern) const {
+    auto order = orderFor(pattern);
+    return equalRange(order, all(order), pattern);
+}
+
+IdRange TripleIndex::all(IndexOrder order) const {
+    auto &v = indexes[static_cast<int>(order)];
+    return { v.data(), v.data() + v.size() };
+}
+
+size_t TripleIndex::size() const {
+    return indexes[0].size();
+}
+
+IndexOrder TripleIndex::orderFor(const IdTriple &pattern) {
+    bool s = pattern.subject != TermDictionary::NoTerm;
+    bool p = pattern.predicate != TermDictionary::NoTerm;
+    bool o = pattern.object != TermDictionary::NoTerm;
+
+    if (p && !s) {
+        return IndexOrder::POS;
+    }
+    if (o && !p) {
+        return IndexOrder::OSP;
+    }
+    return IndexOrder::SPO;
+}
+
+void TripleIndex::sort(IndexOrder order, IdTriple *first, IdTriple *last) {
+    std::sort(first, last, [order](const IdTriple &a, const IdTriple &b) {
+        return key(order, a) < key(order, b);
+    });
+}
+
+IdRange TripleIndex::equalRange(IndexOrder order, IdRange range, const IdTriple &pattern) {
+    auto k = key(order, pattern);
+    int n = boundPrefix(k);
+
+    auto less = [&](const IdTriple &a, const Key &b) {
+        auto ka = key(order, a);
+        return std::lexicographical_compare(ka.begin(), ka.begin() + n, b.begin(), b.begin() + n);
+    };
+    auto greater = [&](const Key &b, const IdTriple &a) {
+        auto ka = key(order, a);
+        return std::lexicographical_compare(b.begin(), b.begin() + n, ka.begin(), ka.begin() + n);
+    };
+
+    auto first = std::lower_bound(range.first, range.last, k, less);
+    auto last = std::upper_bound(first, range.last, k, greater);
+    return { first, last };
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "dictionary.hpp"
+#include <vector>
+
+struct IdTriple {
+    TermId subject, predicate, object;
+
+    bool operator==(const IdTriple &that) const {
+        return (subject == that.subject) &&
+               (predicate == that.predicate) &&
+               (object == that.object);
+    }
+};
+
+/* Set of id triples, open addressing with linear probing.
+ *
+ * Slots hold the triples themselves, so a probe touches a single
+ * cache line in the common case.
+ */
+class TripleSet {
+public:
+    TripleSet();
+
+    // returns false if the triple was already present
+    bool insert(const IdTriple &triple);
+    bool contains(const IdTriple &triple) const;
+    void reserve(size_t count);
+    void clear();
+    size_t size() const;
+    size_t memoryUsage() const;
+
+    static uint64_t hash(const IdTriple &triple);
+
+private:
+    size_t probe(const IdTriple &triple) const;
+    void rehash(size_t capacity);
+
+    // empty slots have subject == TermDictionary::NoTerm
+    std::vector<IdTriple> slots;
+    size_t count = 0;
+};
+
+// component orders of the permutation indexes
+enum class IndexOrder {
+    SPO,
+    POS,
+    OSP
+};
+
+// contiguous run of triples inside an index
+struct IdRange {
+    const IdTriple *first = nullptr, *last = nullptr;
+
+    const IdTriple *begin() const { return first; }
+    const IdTriple *end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+};
+
+/* Sorted permutation indexes over id triples.
+ *
+ * Every pattern with wildcards has its bound components as a prefix
+ * of one of SPO, POS or OSP, so any match is a single range scan.
+ */
+class TripleIndex {
+public:
+    // sorts triples appended since the last call into every index
+    void update(const std::vector<IdTriple> &triples);
+    // merges triples already sorted in the given order into that index,
+    // every order has to get the same triples before the next query
+    void insertSorted(IndexOrder order, const std::vector<IdTriple> &sorted);
+    void clear();
+
+    // TermDictionary::NoTerm components of pattern act as wildcards
+    IdRange match(const IdTriple &pattern) const;
+    IdRange all(IndexOrder order) const;
+    size_t size() const;
+
+    // index order that answers pattern with a single range
+    static IndexOrder orderFor(const IdTriple &pattern);
+    static void sort(IndexOrder order, IdTriple *first, IdTriple *last);
+    // range must be sorted in order, only the leading bound components
+    // of pattern in that order are compared
+    static IdRange equalRange(IndexOrder order, IdRange range, const IdTriple &pattern);
+
+private:
+    // indexed by IndexOrder
+    std::vector<IdTriple> indexes[3];
+};
@@ -3,8 +3,17 @@
 #include <iostream>
 
 int main(int argc, char **argv) {
+    bool emptiness = argc > 1 && std::string{argv[1]} == "-e";
+    if (emptiness) {
+        ++argv;
+        --argc;
+    }
+
     if (argc <= 2) {
-        std::cerr << "Usage: " << argv[0] << " <regex1> <regex2>\n";
+        std::cerr << "Usage: " << argv[0] << " [-e] <regex1> <regex2>\n";
+        std::cerr << "\n";
+        std::cerr << "Prints the intersection DFA in DOT format,\n";
+        std::cerr << "with -e only whether the intersection is empty.\n";
         std::cerr << "\n";
         std::cerr << "Supported regex syntax:\n";
         std::cerr << " - Kleene star: a*\n";
@@ -15,6 +24,10 @@ int main(int argc, char **argv) {
 
     auto dfa = NFA::fromRegex(argv[1]).determinize();
     auto dfa2 = NFA::fromRegex(argv[2]).determinize();
+    if (emptiness) {
+        std::cout << (dfa.intersects(dfa2) ? "nonempty" : "empty") << std::endl;
+        return 0;
+    }
     dfa.intersect(dfa2);
     std::cout << dfa;
     return 0;
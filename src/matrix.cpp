@@ -0,0 +1,107 @@
+#include "matrix.hpp"
+#include <algorithm>
+
+BitMatrix::BitMatrix(size_t rows, size_t cols) :
+    height(rows),
+    width(cols),
+    stride((cols + 63) / 64),
+    bits(height * stride, 0) {}
+
+size_t BitMatrix::rows() const {
+    return height;
+}
+
+size_t BitMatrix::cols() const {
+    return width;
+}
+
+size_t BitMatrix::words() const {
+    return stride;
+}
+
+size_t BitMatrix::count() const {
+    size_t res = 0;
+    for (auto w : bits) {
+        res += __builtin_popcountll(w);
+    }
+    return res;
+}
+
+void BitMatrix::orRow(uint64_t *dst, const uint64_t *src, size_t words) {
+    for (size_t i = 0; i < words; ++i) {
+        dst[i] |= src[i];
+    }
+}
+
+bool BitMatrix::andNotRow(uint64_t *dst, const uint64_t *mask, size_t words) {
+    uint64_t any = 0;
+    for (size_t i = 0; i < words; ++i) {
+        dst[i] &= ~mask[i];
+        any |= dst[i];
+    }
+    return any != 0;
+}
+
+void BitMatrix::clearRow(uint64_t *dst, size_t words) {
+    for (size_t i = 0; i < words; ++i) {
+        dst[i] = 0;
+    }
+}
+
+SparseMatrix::SparseMatrix(size_t rows) : offsets(rows + 1, 0) {}
+
+SparseMatrix SparseMatrix::forPredicate(const CsrGraph &graph, uint32_t predicate) {
+    SparseMatrix res(graph.termCount());
+    for (TermId v = 0; v < graph.termCount(); ++v) {
+        for (auto &e : graph.edges(v, predicate)) {
+            res.cols.push_back(e.target);
+        }
+        res.offsets[v + 1] = res.cols.size();
+    }
+    return res;
+}
+
+std::vector<SparseMatrix> SparseMatrix::forPredicates(const CsrGraph &graph, const std::vector<char> &used) {
+    std::vector<SparseMatrix> res(used.size());
+    // rows up to filled[p] have their final offsets
+    std::vector<size_t> filled(used.size(), 0);
+    for (uint32_t p = 0; p < used.size(); ++p) {
+        if (used[p]) {
+            res[p] = SparseMatrix(graph.termCount());
+        }
+    }
+
+    for (TermId v = 0; v < graph.termCount(); ++v) {
+        auto edges = graph.edges(v);
+        // edges are ordered by predicate, take one span at a time
+        for (auto e = edges.begin(); e != edges.end(); ) {
+            uint32_t p = e->predicate;
+            auto first = e;
+            while (e != edges.end() && e->predicate == p) ++e;
+            if (!used[p]) continue;
+
+            auto &m = res[p];
+            std::fill(m.offsets.begin() + filled[p] + 1, m.offsets.begin() + v + 1, m.cols.size());
+            for (; first != e; ++first) {
+                m.cols.push_back(first->target);
+            }
+            m.offsets[v + 1] = m.cols.size();
+            filled[p] = v + 1;
+        }
+    }
+
+    for (uint32_t p = 0; p < used.size(); ++p) {
+        if (used[p]) {
+            std::fill(res[p].offsets.begin() + filled[p] + 1, res[p].offsets.end(), res[p].cols.size());
+        }
+    }
+    return res;
+}
+
+size_t SparseMatrix::rows() const {
+    return offsets.size() - 1;
+}
+
+size_t SparseMatrix::size() const {
+    return cols.size();
+}
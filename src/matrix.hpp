@@ -0,0 +1,79 @@
+#pragma once
+
+#include "csr.hpp"
+#include <cstdint>
+#include <vector>
+
+/* Dense boolean matrix with bit-packed rows.
+ *
+ * Every row is padded to whole 64-bit words. The row kernels are plain
+ * loops over words, which the compiler turns into vector code.
+ */
+class BitMatrix {
+public:
+    BitMatrix(size_t rows = 0, size_t cols = 0);
+
+    size_t rows() const;
+    size_t cols() const;
+    // words per row
+    size_t words() const;
+
+    uint64_t *row(size_t i) {
+        return bits.data() + i * stride;
+    }
+
+    const uint64_t *row(size_t i) const {
+        return bits.data() + i * stride;
+    }
+
+    bool get(size_t i, size_t j) const {
+        return (row(i)[j >> 6] >> (j & 63)) & 1;
+    }
+
+    void set(size_t i, size_t j) {
+        row(i)[j >> 6] |= uint64_t(1) << (j & 63);
+    }
+
+    // number of set bits
+    size_t count() const;
+
+    // dst |= src
+    static void orRow(uint64_t *dst, const uint64_t *src, size_t words);
+    // dst &= ~mask, returns false if dst became zero
+    static bool andNotRow(uint64_t *dst, const uint64_t *mask, size_t words);
+    static void clearRow(uint64_t *dst, size_t words);
+
+private:
+    size_t height, width, stride;
+    std::vector<uint64_t> bits;
+};
+
+/* Sparse boolean matrix in CSR form, a set entry (i, j) is column j
+ * listed in row i.
+ */
+class SparseMatrix {
+public:
+    SparseMatrix(size_t rows = 0);
+
+    // adjacency of the edges with the given dense predicate index
+    static SparseMatrix forPredicate(const CsrGraph &graph, uint32_t predicate);
+    // adjacency of every predicate p with used[p] set, built in a single
+    // pass over the edges, the other matrices are left empty
+    static std::vector<SparseMatrix> forPredicates(const CsrGraph &graph, const std::vector<char> &used);
+
+    const TermId *begin(size_t i) const {
+        return cols.data() + offsets[i];
+    }
+
+    const TermId *end(size_t i) const {
+        return cols.data() + offsets[i + 1];
+    }
+
+    size_t rows() const;
+    // number of set entries
+    size_t size() const;
+
+private:
+    std::vector<size_t> offsets;
+    std::vector<TermId> cols;
+};
@@ -0,0 +1,62 @@
+#include "mmap.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+
+    length = st.st_size;
+    if (length > 0) {
+        addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        addr = nullptr;
+        throw std::runtime_error("cannot map " + path);
+    }
+}
+
+MappedFile::MappedFile(MappedFile &&that) :
+    addr(that.addr),
+    length(that.length) {
+    that.addr = nullptr;
+    that.length = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile that) {
+    this->swap(that);
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    if (addr) {
+        munmap(addr, length);
+    }
+}
+
+void MappedFile::swap(MappedFile &that) {
+    std::swap(addr, that.addr);
+    std::swap(length, that.length);
+}
+
+const char *MappedFile::data() const {
+    return static_cast<const char*>(addr);
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+    MappedFile(MappedFile &&that);
+    MappedFile &operator=(MappedFile that);
+    ~MappedFile();
+
+    void swap(MappedFile &that);
+
+    const char *data() const;
+    size_t size() const;
+
+private:
+    void *addr = nullptr;
+    size_t length = 0;
+};
@@ -1,31 +1,9 @@
 #include "automaton.hpp"
-#include <sstream>
 #include <algorithm>
-#include <set>
-#include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
-NFA::NFA() {
-    auto node = std::make_unique<NFA::Node>();
-    node->term = true;
-    nodes.emplace_back(std::move(node));
-}
-
-NFA::NFA(const NFA& that) {
-    std::map<Node*, int> indexes;
-    for (auto &node : that.nodes) {
-        indexes[node.get()] = indexes.size();
-        auto t = std::make_unique<Node>();
-        t->term = node->term;
-        nodes.emplace_back(std::move(t));
-    }
-
-    for (auto &node : that.nodes) {
-        auto &t = nodes[indexes[node.get()]];
-        for (auto &[ch, to] : node->trans) {
-            t->trans.insert({ ch, nodes[indexes[to]].get() });
-        }
-    }
-}
+NFA::NFA() : term{ true } {}
 
 NFA &NFA::operator=(NFA that) {
     swap(that);
@@ -33,363 +11,555 @@ NFA &NFA::operator=(NFA that) {
 }
 
 void NFA::swap(NFA &that) {
-    nodes.swap(that.nodes);
+    term.swap(that.term);
+    edges.swap(that.edges);
+    std::swap(start, that.start);
 }
 
 NFA NFA::fromRegex(const std::string &str) {
-    std::istringstream s{str};
-    auto nfa = fromExpr(s);
-    if (s.peek() != -1) {
-        throw ParseException{};
-    }
-    return nfa;
+    return parse(str, nullptr);
 }
 
-NFA NFA::fromExpr(std::istream &s) {
-    auto ch = s.peek();
-    if (ch == -1 || ch == '|' || ch == '*' || ch == ')') {
-        auto nfa = NFA{};
-        return nfa;
-    }
-    auto nfa = fromSeq(s);
-    if (s.peek() == '|') {
-        s.get();
-        nfa.alternative(fromExpr(s));
-    }
-    return nfa;
+NFA NFA::fromRegex(const std::string &str, const SymbolResolver &resolve) {
+    return parse(str, &resolve);
 }
 
-NFA NFA::fromSeq(std::istream &s) {
-    auto nfa = fromStar(s);
+namespace {
+
+// part of an automaton under construction, entered at first and left at last
+struct Fragment {
+    int first = -1, last = -1;
 
-    // to determine whether there are more elements in the sequence,
-    // next character must not be EOF, '|', '*', ')'
-    auto next = s.peek();
-    if (next == -1 || next == '|' || next == '*' || next == ')') {
-        return nfa;
+    bool empty() const {
+        return first == -1;
     }
+};
+
+// an open group: its finished alternatives, the concatenation of the
+// finished units of the current one and the last unit, which a '*'
+// may still apply to
+struct Group {
+    std::vector<Fragment> alternatives;
+    Fragment seq, unit;
+    bool starred = false;
+};
+
+} // namespace
+
+NFA NFA::parse(const std::string &str, const SymbolResolver *resolve) {
+    NFA nfa;
+    nfa.term.clear();
+
+    auto state = [&] {
+        nfa.term.push_back(false);
+        return int(nfa.term.size()) - 1;
+    };
+    auto link = [&](int from, int symbol, int to) {
+        nfa.edges.push_back({ from, symbol, to });
+    };
 
-    nfa.concat(fromSeq(s));
-    return nfa;
-}
+    auto flush = [&](Group &g) {
+        if (g.unit.empty()) return;
+        if (g.seq.empty()) {
+            g.seq = g.unit;
+        } else {
+            link(g.seq.last, Epsilon, g.unit.first);
+            g.seq.last = g.unit.last;
+        }
+        g.unit = {};
+    };
 
-NFA NFA::fromStar(std::istream &s) {
-    auto nfa = fromUnit(s);
-    if (s.peek() == '*') {
-        s.get();
-        nfa.kleene();
-    }
-    return nfa;
-}
+    // an empty alternative matches the empty word
+    auto endAlternative = [&](Group &g) {
+        flush(g);
+        if (g.seq.empty()) {
+            int s = state();
+            g.seq = { s, s };
+        }
+        g.alternatives.push_back(g.seq);
+        g.seq = {};
+    };
+
+    auto close = [&](Group &g) {
+        endAlternative(g);
+        if (g.alternatives.size() == 1) {
+            return g.alternatives[0];
+        }
+        Fragment res{ state(), state() };
+        for (auto &alt : g.alternatives) {
+            link(res.first, Epsilon, alt.first);
+            link(alt.last, Epsilon, res.last);
+        }
+        return res;
+    };
 
-NFA NFA::fromUnit(std::istream &s) {
-    auto ch = s.peek();
+    auto push = [&](Group &g, Fragment unit) {
+        flush(g);
+        g.unit = unit;
+        g.starred = false;
+    };
 
-    if (ch == '|' || ch == ')' || ch == '*' ||  ch == -1) {
-        throw ParseException{};
-    }
+    std::vector<Group> groups(1);
+    for (size_t i = 0; i < str.size(); ++i) {
+        unsigned char ch = str[i];
 
-    if (ch == '(') {
-        s.get();
-        auto nfa = fromExpr(s);
-        if (s.get() != ')') throw ParseException{};
-        return nfa;
+        if (ch == '(') {
+            groups.emplace_back();
+            continue;
+        }
+
+        auto &g = groups.back();
+        if (ch == ')') {
+            if (groups.size() == 1) throw ParseException{};
+            auto unit = close(g);
+            groups.pop_back();
+            push(groups.back(), unit);
+        } else if (ch == '*') {
+            if (g.unit.empty() || g.starred) throw ParseException{};
+            Fragment loop{ state(), state() };
+            link(loop.first, Epsilon, g.unit.first);
+            link(loop.first, Epsilon, loop.last);
+            link(g.unit.last, Epsilon, g.unit.first);
+            link(g.unit.last, Epsilon, loop.last);
+            g.unit = loop;
+            g.starred = true;
+        } else if (ch == '|') {
+            // only the last alternative may be empty
+            flush(g);
+            if (g.seq.empty()) throw ParseException{};
+            endAlternative(g);
+        } else {
+            int symbol = ch;
+            if (resolve) {
+                std::string name(1, char(ch));
+                if (ch == '<') {
+                    auto end = str.find('>', i + 1);
+                    if (end == std::string::npos) throw ParseException{};
+                    name = str.substr(i + 1, end - i - 1);
+                    i = end;
+                }
+                symbol = (*resolve)(name);
+            }
+            Fragment unit{ state(), state() };
+            link(unit.first, symbol, unit.last);
+            push(g, unit);
+        }
     }
 
-    // normal character
-    s.get();
-    auto nfa = NFA{};
-    nfa.addCharacter(ch);
+    if (groups.size() != 1) throw ParseException{};
+    auto whole = close(groups.back());
+    nfa.start = whole.first;
+    nfa.term[whole.last] = true;
     return nfa;
 }
 
-void NFA::addCharacter(int c) {
-    auto term = std::make_unique<NFA::Node>();
-    term->term = true;
-
-    for (auto &node : nodes) {
-        if (!node->term) continue;
-        node->term = false;
-        node->trans.insert({ c, term.get() });
+int NFA::append(const NFA &that) {
+    int offset = term.size();
+    term.insert(term.end(), that.term.begin(), that.term.end());
+    edges.reserve(edges.size() + that.edges.size());
+    for (auto &e : that.edges) {
+        edges.push_back({ e.from + offset, e.symbol, e.to + offset });
     }
-
-    nodes.emplace_back(std::move(term));
+    return offset;
 }
 
-void NFA::concat(NFA that) {
-    for (auto &node : nodes) {
-        if (!node->term) continue;
-        node->term = false;
-        node->trans.insert({ Epsilon, that.nodes[0].get() });
+std::vector<int> NFA::sortedEdges(std::vector<Edge> &sorted) const {
+    // counting sort, edges of a state keep their insertion order
+    std::vector<int> first(term.size() + 1, 0);
+    for (auto &e : edges) {
+        ++first[e.from + 1];
     }
-
-    for (auto &node : that.nodes) {
-        nodes.emplace_back(std::move(node));
+    for (size_t v = 1; v < first.size(); ++v) {
+        first[v] += first[v - 1];
     }
 
-    that.nodes.clear();
+    sorted.resize(edges.size());
+    auto pos = first;
+    for (auto &e : edges) {
+        sorted[pos[e.from]++] = e;
+    }
+    return first;
 }
 
-void NFA::alternative(NFA that) {
-    nodes[0]->trans.insert({ Epsilon, that.nodes[0].get() });
+void NFA::addCharacter(int c) {
+    int to = term.size();
+    for (int v = 0; v < to; ++v) {
+        if (!term[v]) continue;
+        term[v] = false;
+        edges.push_back({ v, c, to });
+    }
+    term.push_back(true);
+}
 
-    for (auto &node : that.nodes) {
-        nodes.emplace_back(std::move(node));
+void NFA::concat(NFA that) {
+    int offset = term.size();
+    for (int v = 0; v < offset; ++v) {
+        if (!term[v]) continue;
+        term[v] = false;
+        edges.push_back({ v, Epsilon, offset + that.start });
     }
+    append(that);
+}
+
+// The start state of a fragment never has incoming transitions:
+// kleene loops back into the old start and alternative branches from
+// a fresh one, otherwise a loop could resume in the other branch.
 
-    that.nodes.clear();
+void NFA::alternative(NFA that) {
+    int offset = append(that);
+    int fresh = term.size();
+    term.push_back(false);
+    edges.push_back({ fresh, Epsilon, start });
+    edges.push_back({ fresh, Epsilon, offset + that.start });
+    start = fresh;
 }
 
 void NFA::kleene() {
-    for (auto &node : nodes) {
-        if (!node->term) continue;
-        node->trans.insert({ Epsilon, nodes[0].get() });
+    int fresh = term.size();
+    for (int v = 0; v < fresh; ++v) {
+        if (!term[v]) continue;
+        edges.push_back({ v, Epsilon, start });
     }
-    nodes[0]->term = true;
+
+    term.push_back(true);
+    edges.push_back({ fresh, Epsilon, start });
+    start = fresh;
 }
 
 void NFA::intersect(const DFA& that) {
     // precondition: NFA doesn't contain epsilon-transitions
-    std::map<Node*, int> thisIdx;
-    std::map<DFA::Node*, int> thatIdx;
-    auto thisNodes = std::move(nodes);
-    nodes.clear();
+    // builds only the pairs reachable from the pair of start states
+    std::vector<Edge> sorted;
+    auto first = sortedEdges(sorted);
+
+    NFA res;
+    res.term.clear();
+    std::unordered_map<uint64_t, int> pairs;
+    std::vector<std::pair<int, int>> queue;
+
+    auto visit = [&](int u, int v) {
+        uint64_t key = uint64_t(u) << 32 | v;
+        auto [it, inserted] = pairs.emplace(key, res.term.size());
+        if (inserted) {
+            res.term.push_back(term[u] && that.states[v].term);
+            queue.emplace_back(u, v);
+        }
+        return it->second;
+    };
 
-    for (auto &node : thisNodes) {
-        thisIdx[node.get()] = thisIdx.size();
-    }
+    visit(start, 0);
 
-    for (auto &node : that.nodes) {
-        thatIdx[node.get()] = thatIdx.size();
-    }
-
-    for (int i = 0; i < thisNodes.size(); ++i) {
-        for (int j = 0; j < that.nodes.size(); ++j) {
-            auto node = std::make_unique<Node>();
-            node->term = thisNodes[i]->term && that.nodes[j]->term;
-            nodes.emplace_back(std::move(node));
+    for (size_t i = 0; i < queue.size(); ++i) {
+        auto [u, v] = queue[i];
+        for (int e = first[u]; e < first[u + 1]; ++e) {
+            int w = that.next(v, sorted[e].symbol);
+            if (w == -1) continue;
+            int to = visit(sorted[e].to, w);
+            res.edges.push_back({ int(i), sorted[e].symbol, to });
         }
     }
 
-    for (int i = 0; i < thisNodes.size(); ++i) {
-        auto &ti = thisNodes[i]->trans;
-        for (int j = 0; j < that.nodes.size(); ++j) {
-            int idx = i * that.nodes.size() + j;
-            auto &tj = that.nodes[j]->trans;
-
-            for (auto &[ch, to] : ti) {
-                if (tj.find(ch) == tj.end()) continue;
-                int u = thisIdx[to];
-                int v = thatIdx[tj[ch]];
-                int tidx = u * that.nodes.size() + v;
-                nodes[idx]->trans.emplace(ch, nodes[tidx].get());
-            }
-        }
-    }
+    swap(res);
 }
 
-DFA NFA::determinize() const {
-    std::map<NFA::Node*, int> indexes;
-    for (auto &node : nodes) {
-        indexes[node.get()] = indexes.size();
+namespace {
+
+// hash and equality of fixed-width bitsets stored back to back in a pool
+struct SubsetHash {
+    const std::vector<uint64_t> &pool;
+    size_t words;
+
+    size_t operator()(size_t i) const {
+        uint64_t h = 0;
+        for (size_t k = 0; k < words; ++k) {
+            h = (h ^ pool[i * words + k]) * 0x9e3779b97f4a7c15ull;
+            h ^= h >> 29;
+        }
+        return h;
     }
+};
 
-    // First of all, construct epsilon equivalent states
-    // To do this, find strongly connected components
+struct SubsetEqual {
+    const std::vector<uint64_t> &pool;
+    size_t words;
 
-    // I use char since std::vector<bool> is too weird, man
-    std::vector<char> used(nodes.size());
+    bool operator()(size_t i, size_t j) const {
+        return std::equal(pool.begin() + i * words, pool.begin() + (i + 1) * words,
+                          pool.begin() + j * words);
+    }
+};
 
-    // topsort order
-    std::vector<int> order;
-    order.reserve(nodes.size());
+void orInto(uint64_t *dst, const uint64_t *src, size_t words) {
+    // plain word loop, vectorized by the compiler
+    for (size_t k = 0; k < words; ++k) {
+        dst[k] |= src[k];
+    }
+}
 
-    // reverse epsilon transitions
-    std::vector<std::vector<int>> rg(nodes.size());
+} // namespace
 
-    // equivalence classes
-    std::vector<int> equiv(nodes.size());
-    std::vector<char> termClass;
+DFA NFA::determinize() const {
+    int n = term.size();
+    std::vector<Edge> sorted;
+    auto first = sortedEdges(sorted);
+
+    // epsilon edges in CSR form
+    std::vector<int> epsStart(n + 1, 0), epsTo;
+    for (int v = 0; v < n; ++v) {
+        for (int e = first[v]; e < first[v + 1]; ++e) {
+            if (sorted[e].symbol == Epsilon) {
+                epsTo.push_back(sorted[e].to);
+            }
+        }
+        epsStart[v + 1] = epsTo.size();
+    }
 
-    std::function<void(int)> dfs1 = [&](int v) {
-        used[v] = 1;
-        for (auto [ch, to] : nodes[v]->trans) {
-            if (ch != Epsilon) {
+    // Collapse strongly connected components of epsilon edges with an
+    // iterative Tarjan. Components come out in reverse topological
+    // order: every epsilon edge leads to a component with a smaller id.
+    std::vector<int> comp(n, -1), order(n, -1), low(n);
+    std::vector<int> stack, calls, edge;
+    int counter = 0, comps = 0;
+
+    for (int root = 0; root < n; ++root) {
+        if (order[root] != -1) continue;
+
+        order[root] = low[root] = counter++;
+        stack.push_back(root);
+        calls.push_back(root);
+        edge.push_back(epsStart[root]);
+
+        while (!calls.empty()) {
+            int v = calls.back();
+            if (edge.back() < epsStart[v + 1]) {
+                int u = epsTo[edge.back()++];
+                if (order[u] == -1) {
+                    order[u] = low[u] = counter++;
+                    stack.push_back(u);
+                    calls.push_back(u);
+                    edge.push_back(epsStart[u]);
+                } else if (comp[u] == -1) {
+                    low[v] = std::min(low[v], order[u]);
+                }
                 continue;
             }
 
-            int u = indexes[to];
-            rg[u].push_back(v);
-            if (used[u]) continue;
-            dfs1(u);
-        }
-        order.push_back(v);
-    };
-
-    for (int i = 0; i < nodes.size(); ++i) {
-        if (!used[i]) {
-            dfs1(i);
+            calls.pop_back();
+            edge.pop_back();
+            if (!calls.empty()) {
+                low[calls.back()] = std::min(low[calls.back()], low[v]);
+            }
+            if (low[v] == order[v]) {
+                int u;
+                do {
+                    u = stack.back();
+                    stack.pop_back();
+                    comp[u] = comps;
+                } while (u != v);
+                ++comps;
+            }
         }
     }
-    used.assign(nodes.size(), 0);
 
-    std::function<void(int, int)> dfs2 = [&](int v, int c) {
-        used[v] = 1;
-        equiv[v] = c;
-
-        if (nodes[v]->term) termClass[c] = 1;
+    std::vector<std::vector<int>> members(comps);
+    for (int v = 0; v < n; ++v) {
+        members[comp[v]].push_back(v);
+    }
 
-        for (int u : rg[v]) {
-            if (used[u]) continue;
-            dfs2(u, c);
+    // Only components with symbol moves or accepting states can tell two
+    // subsets apart (the important states of the dragon book), subsets
+    // keep just those under dense bit numbers. Thompson automata are
+    // mostly epsilon glue, which would otherwise turn, for instance,
+    // every word of an alternation under a star into its own subset.
+    std::vector<int> bit(comps, -1);
+    std::vector<char> accepts;
+    for (int c = 0; c < comps; ++c) {
+        bool important = false, accepting = false;
+        for (int v : members[c]) {
+            accepting |= term[v];
+            important |= first[v + 1] - first[v] > epsStart[v + 1] - epsStart[v];
         }
-    };
-
-    for (auto it = order.rbegin(); it != order.rend(); ++it) {
-        if (!used[*it]) {
-            termClass.push_back(0);
-            dfs2(*it, termClass.size() - 1);
+        if (important || accepting) {
+            bit[c] = accepts.size();
+            accepts.push_back(accepting);
         }
     }
 
-    // Now we have assigned equivalence classes,
-    // let's build transitions map in epsilon-compressed automata
-    std::vector<std::map<int, std::set<int>>> tr(termClass.size());
-
-    for (auto &node : nodes) {
-        int v = equiv[indexes[node.get()]];
-        for (auto [ch, to] : node->trans) {
-            int u = equiv[indexes[to]];
-            tr[v][ch].insert(u);
+    size_t words = accepts.size() / 64 + 1;
+    std::vector<uint64_t> accepting(words, 0);
+    for (size_t b = 0; b < accepts.size(); ++b) {
+        if (accepts[b]) {
+            accepting[b >> 6] |= uint64_t(1) << (b & 63);
         }
     }
 
-    // Build epsilon reachability table
-    std::vector<std::set<int>> eps(termClass.size());
-
-    for (int v = eps.size() - 1; v >= 0; --v) {
-        eps[v].insert(v);
-        for (int u : tr[v][Epsilon]) {
-            termClass[v] |= termClass[u];
-            for (int i : eps[u]) {
-                eps[v].insert(i);
-            }
+    // Epsilon closures of components as bitsets, sinks first. Equal
+    // closures are common and stored once, closure[c] is a pool index.
+    std::vector<uint64_t> closures;
+    std::vector<size_t> closure(comps);
+    std::unordered_set<size_t, SubsetHash, SubsetEqual> distinct(
+        16, SubsetHash{closures, words}, SubsetEqual{closures, words});
+
+    for (int c = 0; c < comps; ++c) {
+        size_t candidate = closures.size() / words;
+        closures.resize(closures.size() + words, 0);
+        auto cl = closures.data() + candidate * words;
+        if (bit[c] != -1) {
+            cl[bit[c] >> 6] |= uint64_t(1) << (bit[c] & 63);
         }
-    }
-
-    for (int v = eps.size() - 1; v >= 0; --v) {
-        for (auto [ch, to] : tr[v]) {
-            std::set<int> res;
-            for (int u : to) {
-                for (int w : eps[u]) {
-                    res.insert(w);
+        for (int v : members[c]) {
+            for (int e = epsStart[v]; e < epsStart[v + 1]; ++e) {
+                int d = comp[epsTo[e]];
+                if (d != c) {
+                    orInto(cl, closures.data() + closure[d] * words, words);
                 }
             }
-            tr[v][ch] = std::move(res);
         }
-    }
 
-    // Okay, now to map subsets of equiv classes to ints
-    std::map<std::set<int>, int> indexesFinal;
-
-    indexesFinal[eps[equiv[0]]] = 0; // start node
-    std::vector<std::set<int>> indexesFinalV{eps[equiv[0]]};
-
-    auto dfa = DFA{};
-    dfa.nodes.resize(indexesFinal.size());
-    for (auto &[s, i] : indexesFinal) {
-        auto node = std::make_unique<DFA::Node>();
-        for (int j : s) {
-            if (termClass[j]) {
-                node->term = true;
-                break;
-            }
+        auto [it, inserted] = distinct.insert(candidate);
+        if (!inserted) {
+            closures.resize(closures.size() - words);
         }
-        dfa.nodes[i] = std::move(node);
+        closure[c] = *it;
     }
 
-    for (int i = 0; i < indexesFinalV.size(); ++i) {
-        auto &s = indexesFinalV[i];
-        std::map<int, std::set<int>> u;
-        auto from = dfa.nodes[i].get();
+    // Symbol moves of every important component, each already
+    // epsilon-closed. A move on a single edge points at the closure of
+    // its target, only several edges on one symbol need a union of their
+    // own. Most target sets are tiny, so every move also records the span
+    // of words that have bits set and unions only touch that span. Moves
+    // into the empty set lead nowhere and are dropped.
+    struct Move {
+        int symbol;
+        size_t at, lo, hi;
+
+        bool operator<(const Move &that) const {
+            return symbol < that.symbol;
+        }
+    };
+
+    size_t shared = closures.size() / words;
+    std::vector<std::vector<Move>> moves(accepts.size());
+    for (int c = 0; c < comps; ++c) {
+        if (bit[c] == -1) continue;
 
-        for (int j : s) {
-            for (auto &[ch, to] : tr[j]) {
+        std::map<int, size_t> bySymbol;
+        for (int v : members[c]) {
+            for (int e = first[v]; e < first[v + 1]; ++e) {
+                int ch = sorted[e].symbol;
                 if (ch == Epsilon) continue;
-                for (int k : to) {
-                    u[ch].insert(k);
+                size_t target = closure[comp[sorted[e].to]];
+                auto [it, inserted] = bySymbol.emplace(ch, target);
+                if (inserted || it->second == target) continue;
+
+                if (it->second < shared) {
+                    size_t copy = closures.size() / words;
+                    closures.resize(closures.size() + words);
+                    std::copy_n(closures.begin() + it->second * words, words, closures.begin() + copy * words);
+                    it->second = copy;
                 }
+                orInto(closures.data() + it->second * words, closures.data() + target * words, words);
             }
         }
 
-        for (auto &[ch, to] : u) {
-            if (to.empty()) continue;
-            if (indexesFinal.find(to) == indexesFinal.end()) {
-                indexesFinal[to] = indexesFinal.size();
-                indexesFinalV.push_back(to);
-                auto node = std::make_unique<DFA::Node>();
-
-                for (int j : to) {
-                    if (termClass[j]) {
-                        node->term = true;
-                        break;
-                    }
-                }
+        for (auto [ch, set] : bySymbol) {
+            size_t at = set * words, lo = 0, hi = words;
+            while (lo < hi && closures[at + lo] == 0) ++lo;
+            while (lo < hi && closures[at + hi - 1] == 0) --hi;
+            if (lo < hi) {
+                moves[bit[c]].push_back({ ch, at, lo, hi });
+            }
+        }
+    }
 
-                dfa.nodes.emplace_back(std::move(node));
+    // Subset construction. Subsets live in a pool and are deduplicated
+    // through a hash set of pool indexes: a candidate is appended to the
+    // pool, and popped again if an equal subset already exists.
+    std::vector<uint64_t> pool(closures.begin() + closure[comp[start]] * words,
+                               closures.begin() + (closure[comp[start]] + 1) * words);
+    std::unordered_map<size_t, int, SubsetHash, SubsetEqual> states(
+        16, SubsetHash{pool, words}, SubsetEqual{pool, words});
+    states.emplace(0, 0);
+
+    auto dfa = DFA{};
+    auto isTerm = [&](size_t i) {
+        for (size_t k = 0; k < words; ++k) {
+            if (pool[i * words + k] & accepting[k]) return true;
+        }
+        return false;
+    };
+    dfa.addState(isTerm(0));
+
+    std::vector<Move> out;
+    for (size_t i = 0; i < dfa.states.size(); ++i) {
+        out.clear();
+        for (size_t k = 0; k < words; ++k) {
+            for (uint64_t bits = pool[i * words + k]; bits; bits &= bits - 1) {
+                int c = k * 64 + __builtin_ctzll(bits);
+                out.insert(out.end(), moves[c].begin(), moves[c].end());
+            }
+        }
+        std::sort(out.begin(), out.end());
+
+        for (size_t j = 0; j < out.size();) {
+            int ch = out[j].symbol;
+            size_t candidate = pool.size() / words;
+            pool.resize(pool.size() + words, 0);
+            for (; j < out.size() && out[j].symbol == ch; ++j) {
+                auto &m = out[j];
+                orInto(pool.data() + candidate * words + m.lo, closures.data() + m.at + m.lo, m.hi - m.lo);
             }
 
-            auto node = dfa.nodes[indexesFinal[to]].get();
-            from->trans[ch] = node;
+            auto [it, inserted] = states.emplace(candidate, dfa.states.size());
+            if (inserted) {
+                dfa.addState(isTerm(candidate));
+            } else {
+                pool.resize(pool.size() - words);
+            }
+            dfa.addTransition(i, ch, it->second);
         }
     }
 
     dfa.minimize();
 
-    // whew
-
     return dfa;
 }
 
 std::ostream &operator<<(std::ostream &os, const NFA &nfa) {
-    // print NFA in DOT graph format
+    // print NFA in DOT graph format, the start state is marked
 
     os << "digraph NFA {" << std::endl;
 
-    std::map<NFA::Node*, int> indexes;
     bool f = false;
-    for (auto &node : nfa.nodes) {
-        indexes[node.get()] = indexes.size();
-        if (node->term) {
+    for (char t : nfa.term) {
+        if (t) {
             f = true;
         }
     }
     if (f) {
         os << "node [shape = doublecircle];";
-        for (auto &node : nfa.nodes) {
-            if (node->term) {
-                os << " " << indexes[node.get()];
+        for (size_t v = 0; v < nfa.term.size(); ++v) {
+            if (nfa.term[v]) {
+                os << " " << v;
             }
         }
         os << ";" << std::endl;
     }
 
     os << "node [shape = circle];" << std::endl;
-
-    for (auto &node : nfa.nodes) {
-        int fromIdx = indexes[node.get()];
-        for (auto [ch, to] : node->trans) {
-            int toIdx = indexes[to];
-            os << fromIdx << " -> " << toIdx;
-            std::string label{(char)ch};
-            if (ch == Epsilon) {
-                label = "eps";
-            }
-            os << " [label = \"" << label << "\" ];" << std::endl;
+    os << nfa.start << " [style = bold];" << std::endl;
+
+    std::vector<NFA::Edge> sorted;
+    nfa.sortedEdges(sorted);
+    for (auto &e : sorted) {
+        os << e.from << " -> " << e.to;
+        std::string label{(char)e.symbol};
+        if (e.symbol == Epsilon) {
+            label = "eps";
         }
+        os << " [label = \"" << label << "\" ];" << std::endl;
     }
 
     os << "}" << std::endl;
     return os;
 }
-
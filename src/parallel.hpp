@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// threads == 0 means one thread per hardware core
+inline unsigned threadCount(unsigned threads) {
+    return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// runs fn(0) .. fn(threads - 1) concurrently, fn(0) on the calling thread
+template <typename F>
+void parallel(unsigned threads, F &&fn) {
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(fn, t);
+    }
+    fn(0);
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+/* Range of chunk indices owned by one thread.
+ *
+ * The owner takes chunks from the front, other threads steal half of
+ * what is left from the back. Both ends live in one atomic word, so
+ * every update is a single compare and swap.
+ */
+class alignas(64) StealingRange {
+public:
+    void reset(uint32_t first, uint32_t last) {
+        range.store(pack(first, last), std::memory_order_relaxed);
+    }
+
+    bool pop(uint32_t &chunk) {
+        auto cur = range.load(std::memory_order_relaxed);
+        while (first(cur) < last(cur)) {
+            if (range.compare_exchange_weak(cur, pack(first(cur) + 1, last(cur)))) {
+                chunk = first(cur);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // moves the back half of victim into this range, which must be empty
+    bool steal(StealingRange &victim) {
+        auto cur = victim.range.load(std::memory_order_relaxed);
+        while (first(cur) < last(cur)) {
+            uint32_t mid = last(cur) - (last(cur) - first(cur) + 1) / 2;
+            if (victim.range.compare_exchange_weak(cur, pack(first(cur), mid))) {
+                reset(mid, last(cur));
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static uint64_t pack(uint32_t first, uint32_t last) {
+        return uint64_t(first) << 32 | last;
+    }
+
+    static uint32_t first(uint64_t range) {
+        return range >> 32;
+    }
+
+    static uint32_t last(uint64_t range) {
+        return uint32_t(range);
+    }
+
+    std::atomic<uint64_t> range{0};
+};
+
+/* Calls fn(thread, chunk) for every chunk in [0, chunks) on the given
+ * number of threads. Chunks start out split evenly, a thread that runs
+ * out steals from the others until no work is left anywhere.
+ */
+template <typename F>
+void forEachChunk(unsigned threads, uint32_t chunks, F &&fn) {
+    std::vector<StealingRange> ranges(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        ranges[t].reset(uint64_t(chunks) * t / threads, uint64_t(chunks) * (t + 1) / threads);
+    }
+
+    parallel(threads, [&](unsigned t) {
+        uint32_t chunk;
+        for (;;) {
+            while (ranges[t].pop(chunk)) {
+                fn(t, chunk);
+            }
+
+            // chunks are never added, so one unsuccessful round means done
+            bool stolen = false;
+            for (unsigned i = 1; i < threads && !stolen; ++i) {
+                stolen = ranges[t].steal(ranges[(t + i) % threads]);
+            }
+            if (!stolen) return;
+        }
+    });
+}
+
+/* Bounded queue of reusable slots between one producer and one consumer.
+ *
+ * The producer fills the slot returned by back() and publishes it with
+ * push(), the consumer reads front() and hands the slot back with pop().
+ * Each index is advanced by one side only, so no locks are needed while
+ * slots are available. A side that finds the ring full or empty yields
+ * for a while and then sleeps on a condition variable until the other
+ * one catches up, finishes or closes the ring; the lock is only taken
+ * when somebody sleeps.
+ */
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : slots(capacity) {}
+
+    // producer: a free slot, nullptr once the consumer closed the ring
+    T *back() {
+        size_t h = head.load(std::memory_order_relaxed);
+        auto full = [&] { return h - tail.load(std::memory_order_acquire) == slots.size(); };
+        for (unsigned spins = 0; full(); ++spins) {
+            if (closed.load(std::memory_order_acquire)) return nullptr;
+            if (spins < SpinLimit) {
+                std::this_thread::yield();
+            } else {
+                park([&] { return !full() || closed.load(std::memory_order_acquire); });
+            }
+        }
+        return &slots[h % slots.size()];
+    }
+
+    void push() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        wake();
+    }
+
+    // producer: nothing more will be pushed
+    void finish() {
+        finished.store(true, std::memory_order_release);
+        wake();
+    }
+
+    // consumer: the oldest published slot, nullptr once the producer
+    // finished and every slot has been consumed
+    T *front() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        auto empty = [&] { return head.load(std::memory_order_acquire) == t; };
+        for (unsigned spins = 0; empty(); ++spins) {
+            if (finished.load(std::memory_order_acquire)) {
+                // pushes before finish() are visible now
+                if (empty()) return nullptr;
+                break;
+            }
+            if (spins < SpinLimit) {
+                std::this_thread::yield();
+            } else {
+                park([&] { return !empty() || finished.load(std::memory_order_acquire); });
+            }
+        }
+        return &slots[t % slots.size()];
+    }
+
+    void pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        wake();
+    }
+
+    // consumer: stop the producer, back() returns nullptr from now on
+    void close() {
+        closed.store(true, std::memory_order_release);
+        wake();
+    }
+
+private:
+    // yields before a waiting side goes to sleep
+    static constexpr unsigned SpinLimit = 64;
+
+    // sleeps until ready() holds. The sleeper is counted under the lock
+    // and both fences order the count against the index, so a wake()
+    // either sees the sleeper or the sleeper sees the new index.
+    template <typename F>
+    void park(F &&ready) {
+        std::unique_lock<std::mutex> lock(mutex);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        changed.wait(lock, ready);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            changed.notify_all();
+        }
+    }
+
+    std::vector<T> slots;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) std::atomic<bool> finished{false}, closed{false};
+    std::atomic<unsigned> sleepers{0};
+    std::mutex mutex;
+    std::condition_variable changed;
+};
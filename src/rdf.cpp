@@ -1,8 +1,205 @@
 #include "rdf.hpp"
+#include "compress.hpp"
+#include "mmap.hpp"
 #include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+// serd byte source over a block of memory
+struct MemorySource {
+    const char *data;
+    size_t size;
+
+    static size_t read(void *buf, size_t size, size_t nmemb, void *stream) {
+        auto self = static_cast<MemorySource*>(stream);
+        size_t n = std::min(size * nmemb, self->size);
+        std::memcpy(buf, self->data, n);
+        self->data += n;
+        self->size -= n;
+        return n;
+    }
+
+    static int error(void *) {
+        return 0;
+    }
+};
+
+// serd byte source over a ByteSource. Exceptions must not unwind
+// through serd, so an error of the source is kept and reported later.
+struct StreamSource {
+    const ByteSource &source;
+    size_t bytes = 0;
+    std::exception_ptr failure;
+
+    explicit StreamSource(const ByteSource &source) : source(source) {}
+
+    static size_t read(void *buf, size_t size, size_t nmemb, void *stream) {
+        auto self = static_cast<StreamSource*>(stream);
+        // serd takes a short page for the end of the input, fill it up
+        size_t want = size * nmemb, n = 0;
+        try {
+            while (n < want) {
+                size_t got = self->source(static_cast<char*>(buf) + n, want - n);
+                if (got == 0) break;
+                n += got;
+            }
+        } catch (...) {
+            self->failure = std::current_exception();
+        }
+        self->bytes += n;
+        return n;
+    }
+
+    static int error(void *stream) {
+        return static_cast<StreamSource*>(stream)->failure != nullptr;
+    }
+};
+
+// keeps the first syntax error serd reports
+struct SyntaxErrors {
+    unsigned line = 0, column = 0;
+    std::string message;
+
+    static SerdStatus sink(void *handle, const SerdError *error) {
+        auto self = static_cast<SyntaxErrors*>(handle);
+        if (!self->message.empty()) {
+            return SERD_SUCCESS;
+        }
+
+        char message[256];
+        va_list args;
+        va_copy(args, *error->args);
+        std::vsnprintf(message, sizeof message, error->fmt, args);
+        va_end(args);
+
+        self->line = error->line;
+        self->column = error->col;
+        self->message = message;
+        while (!self->message.empty() && self->message.back() == '\n') {
+            self->message.pop_back();
+        }
+        return SERD_SUCCESS;
+    }
+
+    // lines are shifted by skipped, the lines before the parsed input
+    [[noreturn]] void raise(size_t skipped = 0) const {
+        throw std::runtime_error(
+            "syntax error at " + std::to_string(line + skipped) + ":" + std::to_string(column) + ": " + message);
+    }
+};
+
+// collects statements of a streaming read and adds them in batches.
+// The graph and the progress callback may throw, which must not unwind
+// through serd, so the exception is kept and reading stops.
+struct BatchSink {
+    Graph &graph;
+    const RdfStreamOptions &options;
+    const StreamSource &source;
+    TripleBuffer buffer;
+    size_t statements = 0;
+    bool stopped = false;
+    std::exception_ptr failure;
+
+    BatchSink(Graph &graph, const RdfStreamOptions &options, const StreamSource &source) :
+        graph(graph), options(options), source(source) {}
+
+    // returns false if the progress callback asks to stop
+    bool flush() {
+        statements += buffer.triples.size();
+        graph.addTriples(buffer);
+        buffer.clear();
+        return !options.progress || options.progress(source.bytes, statements);
+    }
+
+    static SerdStatus sink(
+            void *handle,
+            SerdStatementFlags flags,
+            const SerdNode *graph,
+            const SerdNode *subject,
+            const SerdNode *predicate,
+            const SerdNode *object,
+            const SerdNode *object_datatype,
+            const SerdNode *object_lang) {
+        (void)flags;
+        (void)graph;
+        (void)object_datatype;
+        (void)object_lang;
+
+        auto self = static_cast<BatchSink*>(handle);
+        if (self->stopped) {
+            return SERD_FAILURE;
+        }
+        try {
+            self->buffer.add(
+                std::string_view{(char*)subject->buf, subject->n_bytes},
+                std::string_view{(char*)predicate->buf, predicate->n_bytes},
+                std::string_view{(char*)object->buf, object->n_bytes}
+            );
+            if (self->buffer.triples.size() < self->options.batchSize || self->flush()) {
+                return SERD_SUCCESS;
+            }
+        } catch (...) {
+            self->failure = std::current_exception();
+        }
+        // a failing sink makes serd give up on the chunk
+        self->stopped = true;
+        return SERD_FAILURE;
+    }
+};
+
+// collects the statements of one chunk of a parallel read. Exceptions
+// must not unwind through serd or out of the worker thread, so they are
+// kept and rethrown after the workers are joined.
+struct ChunkSink {
+    TripleBuffer buffer;
+    SyntaxErrors errors;
+    std::exception_ptr failure;
+
+    static SerdStatus sink(
+            void *handle,
+            SerdStatementFlags flags,
+            const SerdNode *graph,
+            const SerdNode *subject,
+            const SerdNode *predicate,
+            const SerdNode *object,
+            const SerdNode *object_datatype,
+            const SerdNode *object_lang) {
+        (void)flags;
+        (void)graph;
+        (void)object_datatype;
+        (void)object_lang;
+
+        auto self = static_cast<ChunkSink*>(handle);
+        try {
+            self->buffer.add(
+                std::string_view{(char*)subject->buf, subject->n_bytes},
+                std::string_view{(char*)predicate->buf, predicate->n_bytes},
+                std::string_view{(char*)object->buf, object->n_bytes}
+            );
+        } catch (...) {
+            self->failure = std::current_exception();
+            return SERD_FAILURE;
+        }
+        return SERD_SUCCESS;
+    }
+};
+
+const size_t PageSize = 4096;
+
+} // namespace
 
 RdfReader::RdfReader(RdfFormat fmt, Graph &graph) : graph(graph) {
-    SerdSyntax syntax;
     switch (fmt) {
         case RdfFormat::Turtle:
             syntax = SERD_TURTLE;
@@ -20,6 +217,7 @@ RdfReader::RdfReader(RdfFormat fmt, Graph &graph) : graph(graph) {
 }
 
 RdfReader::RdfReader(RdfReader &&that) :
+    syntax(that.syntax),
     reader(that.reader),
     graph(that.graph) {
     that.reader = nullptr;
@@ -37,6 +235,7 @@ RdfReader::~RdfReader() {
 }
 
 void RdfReader::swap(RdfReader &that) {
+    std::swap(syntax, that.syntax);
     std::swap(reader, that.reader);
 }
 
@@ -48,6 +247,137 @@ void RdfReader::readString(const std::string &data) {
     serd_reader_read_string(reader, (uint8_t*)data.c_str());
 }
 
+void RdfReader::readFileParallel(const std::string &path, unsigned threads) {
+    if (syntax != SERD_NTRIPLES) {
+        readUri(path);
+        return;
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    MappedFile file{path};
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+
+    // split into roughly equal chunks, moving each cut past the next newline
+    std::vector<const char*> cuts{begin};
+    for (unsigned i = 1; i < threads; ++i) {
+        const char *cut = std::max(cuts.back(), begin + file.size() / threads * i);
+        cut = std::find(cut, end, '\n');
+        cuts.push_back(cut == end ? end : cut + 1);
+    }
+    cuts.push_back(end);
+
+    std::vector<ChunkSink> chunks(threads);
+    std::vector<std::thread> workers;
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            auto &chunk = chunks[i];
+            try {
+                std::unique_ptr<SerdReader, decltype(&serd_reader_free)> parser{
+                    serd_reader_new(
+                        SERD_NTRIPLES, static_cast<void*>(&chunk), nullptr,
+                        nullptr, nullptr, ChunkSink::sink, nullptr
+                    ),
+                    serd_reader_free
+                };
+                serd_reader_set_error_sink(parser.get(), SyntaxErrors::sink, &chunk.errors);
+                MemorySource source{cuts[i], size_t(cuts[i + 1] - cuts[i])};
+                auto status = serd_reader_read_source(
+                    parser.get(), MemorySource::read, MemorySource::error,
+                    &source, (const uint8_t*)path.c_str(), PageSize
+                );
+                // SERD_FAILURE only means the input ended early
+                if (status > SERD_FAILURE && !chunk.failure && chunk.errors.message.empty()) {
+                    chunk.errors.message = (const char*)serd_strerror(status);
+                }
+            } catch (...) {
+                chunk.failure = std::current_exception();
+            }
+        });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    // nothing is added unless every chunk was read
+    for (unsigned i = 0; i < threads; ++i) {
+        if (chunks[i].failure) {
+            std::rethrow_exception(chunks[i].failure);
+        }
+        if (!chunks[i].errors.message.empty()) {
+            chunks[i].errors.raise(std::count(begin, cuts[i], '\n'));
+        }
+    }
+
+    for (auto &chunk : chunks) {
+        graph.addTriples(chunk.buffer);
+        chunk.buffer.clear();
+    }
+}
+
+bool RdfReader::readSource(const ByteSource &source, const RdfStreamOptions &options) {
+    StreamSource stream{source};
+    BatchSink batches{graph, options, stream};
+    std::unique_ptr<SerdReader, decltype(&serd_reader_free)> parser{
+        serd_reader_new(
+            syntax, static_cast<void*>(&batches), nullptr,
+            nullptr, nullptr, BatchSink::sink, nullptr
+        ),
+        serd_reader_free
+    };
+    SyntaxErrors errors;
+    serd_reader_set_error_sink(parser.get(), SyntaxErrors::sink, &errors);
+
+    // serd_reader_read_chunk fails both at the end of the input and on
+    // a syntax error, only the error sink tells them apart
+    serd_reader_start_source_stream(
+        parser.get(), StreamSource::read, StreamSource::error,
+        &stream, nullptr, std::max<size_t>(options.chunkSize, 2)
+    );
+    while (!batches.stopped && serd_reader_read_chunk(parser.get()) == SERD_SUCCESS) {}
+    serd_reader_end_stream(parser.get());
+
+    if (!batches.stopped) {
+        batches.flush();
+    }
+    if (batches.failure) {
+        std::rethrow_exception(batches.failure);
+    }
+    if (stream.failure) {
+        std::rethrow_exception(stream.failure);
+    }
+    if (!errors.message.empty()) {
+        errors.raise();
+    }
+    return !batches.stopped;
+}
+
+bool RdfReader::readStream(int fd, const RdfStreamOptions &options) {
+    return readSource([fd](char *buf, size_t size) {
+        for (;;) {
+            ssize_t n = ::read(fd, buf, size);
+            if (n >= 0) {
+                return size_t(n);
+            }
+            if (errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "read");
+            }
+        }
+    }, options);
+}
+
+bool RdfReader::readFile(const std::string &path, const RdfStreamOptions &options) {
+    DecompressingReader input{path};
+    return readSource([&](char *buf, size_t size) {
+        return input.read(buf, size);
+    }, options);
+}
+
 SerdStatus RdfReader::statementSink(
         void *handle,
         SerdStatementFlags flags,
@@ -63,11 +393,11 @@ SerdStatus RdfReader::statementSink(
     (void)object_lang;
 
     auto self = reinterpret_cast<RdfReader*>(handle);
-    self->graph.addTriple( Triple {
-            (char*)subject->buf,
-            (char*)predicate->buf,
-            (char*)object->buf
-    });
+    self->graph.addStatement(
+        std::string_view{(char*)subject->buf, subject->n_bytes},
+        std::string_view{(char*)predicate->buf, predicate->n_bytes},
+        std::string_view{(char*)object->buf, object->n_bytes}
+    );
 
     return SERD_SUCCESS;
 }
@@ -2,6 +2,7 @@
 
 #include "graph.hpp"
 #include <serd/serd.h>
+#include <functional>
 #include <string>
 
 enum class RdfFormat {
@@ -9,6 +10,19 @@ enum class RdfFormat {
     NTriples
 };
 
+// pulls at most size bytes into buf, returns 0 at the end of the input
+using ByteSource = std::function<size_t(char *buf, size_t size)>;
+
+struct RdfStreamOptions {
+    // bytes requested from the source at a time
+    size_t chunkSize = 1 << 16;
+    // statements collected before they are added to the graph
+    size_t batchSize = 1 << 16;
+    // called after every batch with the bytes and statements read so
+    // far, returning false stops reading
+    std::function<bool(size_t bytes, size_t statements)> progress;
+};
+
 class RdfReader {
 public:
     RdfReader(RdfFormat fmt, Graph &graph);
@@ -21,6 +35,36 @@ public:
     void readUri(const std::string &uri);
     void readString(const std::string &data);
 
+    /* Reads a local N-Triples file on several threads.
+     *
+     * The mapped file is split at line boundaries, every chunk is parsed
+     * into its own TripleBuffer and the buffers are added to the graph
+     * in file order. Other formats fall back to readUri.
+     * threads == 0 means one thread per hardware core. The graph is
+     * only changed if every chunk was read: an error of a worker is
+     * rethrown after all of them finished and a syntax error throws
+     * std::runtime_error.
+     */
+    void readFileParallel(const std::string &path, unsigned threads = 0);
+
+    /* Reads a document incrementally from a byte source.
+     *
+     * The source is pulled one chunk at a time, statements are collected
+     * in a TripleBuffer and added to the graph in batches, so memory
+     * stays bounded by the chunk and batch sizes whatever the size of
+     * the input. Reading is driven by the parser: a producer feeding the
+     * source through a pipe blocks while the graph is busy. Statements
+     * read before an error are kept, errors of the source are rethrown
+     * and a syntax error ends the read with std::runtime_error.
+     * Returns false if the progress callback stopped reading.
+     */
+    bool readSource(const ByteSource &source, const RdfStreamOptions &options = {});
+    // readSource over a file descriptor, e.g. a file, pipe or socket
+    bool readStream(int fd, const RdfStreamOptions &options = {});
+    // readSource over a local file; gzip and zstd files, e.g. dump.nt.gz,
+    // are decompressed on a separate thread while the parser runs
+    bool readFile(const std::string &path, const RdfStreamOptions &options = {});
+
 private:
     static SerdStatus statementSink(
             void *handle,
@@ -32,6 +76,7 @@ private:
             const SerdNode *object_datatype,
             const SerdNode *object_lang);
 
+    SerdSyntax syntax;
     SerdReader *reader;
     Graph &graph;
 };
@@ -0,0 +1,498 @@
+#include "rpq.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+DFA compile(const CsrGraph &graph, const TermDictionaryView &terms, const std::string &regex) {
+    return DFA::fromRegex(regex, [&](const std::string &name) {
+        auto id = terms.find(name);
+        if (id == TermDictionaryView::NoTerm) {
+            return int(graph.predicateCount());
+        }
+        return int(graph.predicateIndex(id));
+    });
+}
+
+// frontier chunk sizes of the parallel search, in pairs and in nodes
+const size_t TopDownChunk = 256;
+const size_t BottomUpChunk = 1024;
+
+// direction switching thresholds from Beamer et al.: go bottom-up once
+// the frontier has more than 1/Alpha of the unexplored edges, go back
+// once it holds fewer than 1/Beta of all pairs
+const size_t Alpha = 14;
+const size_t Beta = 24;
+
+// per-thread output of a level, padded against false sharing
+struct alignas(64) LevelOutput {
+    std::vector<uint64_t> frontier;
+    std::vector<TermId> ends;
+};
+
+bool testAndSet(std::vector<uint64_t> &bits, uint64_t i) {
+    auto mask = uint64_t(1) << (i & 63);
+    if (bits[i >> 6] & mask) {
+        return false;
+    }
+    bits[i >> 6] |= mask;
+    return true;
+}
+
+bool isSet(const std::vector<std::atomic<uint64_t>> &bits, uint64_t i) {
+    return (bits[i >> 6].load(std::memory_order_relaxed) >> (i & 63)) & 1;
+}
+
+// calls fn(i - first) for every set bit i in [first, first + count)
+template <typename F>
+void forEachBit(const std::vector<uint64_t> &bits, uint64_t first, uint64_t count, F &&fn) {
+    uint64_t last = first + count;
+    for (uint64_t w = first >> 6; w << 6 < last; ++w) {
+        uint64_t word = bits[w];
+        if (w == first >> 6) {
+            word &= ~uint64_t(0) << (first & 63);
+        }
+        if ((w + 1) << 6 > last) {
+            word &= ~uint64_t(0) >> (64 - (last & 63));
+        }
+        for (; word; word &= word - 1) {
+            fn(int32_t((w << 6) + __builtin_ctzll(word) - first));
+        }
+    }
+}
+
+} // namespace
+
+PathQuery::PathQuery(const CsrGraph &graph, const TermDictionaryView &terms, const std::string &regex,
+                     PathEngine engine) :
+    graph(graph),
+    dfa(compile(graph, terms, regex)),
+    engine(engine) {
+
+    if (engine != PathEngine::Matrix) {
+        return;
+    }
+
+    moves.resize(dfa.size());
+    std::vector<char> used(graph.predicateCount(), 0);
+    for (int32_t q = 0; q < dfa.size(); ++q) {
+        for (uint32_t p = 0; p < graph.predicateCount(); ++p) {
+            auto to = dfa.next(q, p);
+            if (to == dfa.dead()) continue;
+
+            moves[q].emplace_back(p, to);
+            used[p] = 1;
+        }
+    }
+    adjacency = SparseMatrix::forPredicates(graph, used);
+}
+
+std::vector<NodePair> PathQuery::evaluate() const {
+    std::vector<TermId> starts;
+    for (TermId v = 0; v < graph.termCount(); ++v) {
+        if (graph.hasNode(v)) {
+            starts.push_back(v);
+        }
+    }
+    return evaluate(starts);
+}
+
+std::vector<NodePair> PathQuery::evaluate(TermId start) const {
+    if (engine == PathEngine::Matrix) {
+        return evaluate(std::vector<TermId>{ start });
+    }
+
+    Search state;
+    std::vector<NodePair> res;
+    if (start < graph.termCount() && graph.hasNode(start)) {
+        search(start, state, res);
+    }
+    return res;
+}
+
+std::vector<NodePair> PathQuery::evaluate(const std::vector<TermId> &starts) const {
+    std::vector<TermId> sources;
+    for (auto v : starts) {
+        if (v < graph.termCount() && graph.hasNode(v)) {
+            sources.push_back(v);
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+    sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+    std::vector<NodePair> res;
+    if (engine == PathEngine::Matrix) {
+        MatrixSearch state;
+        for (size_t i = 0; i < sources.size(); i += MatrixBlock) {
+            multiply(sources.data() + i, std::min(MatrixBlock, sources.size() - i), state, res);
+        }
+        return res;
+    }
+
+    BatchSearch state;
+    for (size_t i = 0; i < sources.size(); i += 64) {
+        search(sources.data() + i, std::min<size_t>(64, sources.size() - i), state, res);
+    }
+    return res;
+}
+
+std::vector<NodePair> PathQuery::evaluateParallel(TermId start, unsigned threads) const {
+    threads = threadCount(threads);
+    std::vector<NodePair> res;
+    if (start >= graph.termCount() || !graph.hasNode(start)) {
+        return res;
+    }
+
+    uint64_t states = dfa.size();
+    size_t nodes = graph.termCount();
+    std::vector<std::atomic<uint64_t>> visited((nodes * states + 63) / 64);
+    // plain bitmap of the current frontier, only used bottom-up
+    std::vector<uint64_t> current;
+    std::vector<LevelOutput> out(threads);
+
+    auto claim = [&](uint64_t pair) {
+        auto mask = uint64_t(1) << (pair & 63);
+        auto &word = visited[pair >> 6];
+        return !(word.load(std::memory_order_relaxed) & mask) &&
+               !(word.fetch_or(mask, std::memory_order_relaxed) & mask);
+    };
+
+    std::vector<uint64_t> frontier{ start * states + dfa.start() };
+    std::vector<TermId> ends;
+    claim(frontier[0]);
+    if (dfa.accepting(dfa.start())) {
+        ends.push_back(start);
+    }
+
+    // states some transition leads to, the others are never claimed
+    // bottom-up and must not keep a node open
+    std::vector<char> enterable(states, 0);
+    for (int32_t q = 0; q < dfa.dead(); ++q) {
+        for (uint32_t p = 0; p < graph.predicateCount(); ++p) {
+            enterable[dfa.next(q, p)] = 1;
+        }
+    }
+    enterable[dfa.dead()] = 0;
+
+    size_t unexplored = graph.edgeCount() * states;
+    bool bottomUp = false;
+
+    while (!frontier.empty()) {
+        size_t frontierEdges = 0;
+        for (auto pair : frontier) {
+            frontierEdges += graph.edges(pair / states).size();
+        }
+        unexplored -= std::min(unexplored, frontierEdges);
+
+        if (!bottomUp && frontierEdges > unexplored / Alpha) {
+            bottomUp = true;
+        } else if (bottomUp && frontier.size() < nodes * states / Beta) {
+            bottomUp = false;
+        }
+
+        if (!bottomUp) {
+            uint32_t chunks = (frontier.size() + TopDownChunk - 1) / TopDownChunk;
+            forEachChunk(std::min<uint32_t>(threads, chunks), chunks, [&](unsigned t, uint32_t chunk) {
+                auto &local = out[t];
+                auto last = std::min(frontier.size(), (chunk + 1) * TopDownChunk);
+                for (size_t i = chunk * TopDownChunk; i < last; ++i) {
+                    TermId v = frontier[i] / states;
+                    int32_t q = frontier[i] % states;
+
+                    auto edges = graph.edges(v);
+                    for (auto e = edges.begin(); e != edges.end(); ) {
+                        auto predicate = e->predicate;
+                        auto to = dfa.next(q, predicate);
+                        if (to == dfa.dead()) {
+                            while (e != edges.end() && e->predicate == predicate) ++e;
+                            continue;
+                        }
+                        for (; e != edges.end() && e->predicate == predicate; ++e) {
+                            auto pair = e->target * states + to;
+                            if (claim(pair)) {
+                                local.frontier.push_back(pair);
+                                if (dfa.accepting(to)) local.ends.push_back(e->target);
+                            }
+                        }
+                    }
+                }
+            });
+        } else {
+            // every unvisited pair looks for a parent in the frontier
+            current.resize(visited.size());
+            for (auto pair : frontier) {
+                current[pair >> 6] |= uint64_t(1) << (pair & 63);
+            }
+
+            uint32_t chunks = (nodes + BottomUpChunk - 1) / BottomUpChunk;
+            forEachChunk(threads, chunks, [&](unsigned t, uint32_t chunk) {
+                auto &local = out[t];
+                TermId last = std::min(nodes, (chunk + 1) * BottomUpChunk);
+                for (TermId v = chunk * BottomUpChunk; v < last; ++v) {
+                    if (!graph.hasNode(v)) continue;
+
+                    // pairs of v that can still be claimed, only this
+                    // thread claims them
+                    uint64_t base = v * states;
+                    size_t open = 0;
+                    for (int32_t q = 0; q < dfa.dead(); ++q) {
+                        open += enterable[q] && !isSet(visited, base + q);
+                    }
+
+                    auto edges = graph.reverseEdges(v);
+                    for (auto e = edges.begin(); open > 0 && e != edges.end(); ++e) {
+                        forEachBit(current, e->target * states, states, [&](int32_t q) {
+                            auto to = dfa.next(q, e->predicate);
+                            if (to == dfa.dead() || !claim(base + to)) return;
+                            --open;
+                            local.frontier.push_back(base + to);
+                            if (dfa.accepting(to)) local.ends.push_back(v);
+                        });
+                    }
+                }
+            });
+
+            // clear only what was set, the map is as large as visited
+            for (auto pair : frontier) {
+                current[pair >> 6] = 0;
+            }
+        }
+
+        frontier.clear();
+        for (auto &local : out) {
+            frontier.insert(frontier.end(), local.frontier.begin(), local.frontier.end());
+            ends.insert(ends.end(), local.ends.begin(), local.ends.end());
+            local.frontier.clear();
+            local.ends.clear();
+        }
+    }
+
+    // the claim order depends on scheduling, the sorted set does not
+    std::sort(ends.begin(), ends.end());
+    ends.erase(std::unique(ends.begin(), ends.end()), ends.end());
+    for (auto v : ends) {
+        res.emplace_back(start, v);
+    }
+    return res;
+}
+
+const CompiledDFA &PathQuery::automaton() const {
+    return dfa;
+}
+
+void PathQuery::search(TermId start, Search &state, std::vector<NodePair> &res) const {
+    // pair (v, q) has index v * states + q in visited and in the queue
+    uint64_t states = dfa.size();
+    state.visited.resize((graph.termCount() * states + 63) / 64);
+    state.queue.clear();
+    state.ends.clear();
+
+    auto pair = start * states + dfa.start();
+    testAndSet(state.visited, pair);
+    state.queue.push_back(pair);
+
+    for (size_t i = 0; i < state.queue.size(); ++i) {
+        TermId v = state.queue[i] / states;
+        int32_t q = state.queue[i] % states;
+
+        if (dfa.accepting(q)) {
+            state.ends.push_back(v);
+        }
+
+        for (auto &e : graph.edges(v)) {
+            auto to = dfa.next(q, e.predicate);
+            if (to == dfa.dead()) continue;
+
+            pair = e.target * states + to;
+            if (testAndSet(state.visited, pair)) {
+                state.queue.push_back(pair);
+            }
+        }
+    }
+
+    // only the visited pairs are set, clearing them is cheaper than
+    // clearing the whole bitset for every start node
+    for (auto p : state.queue) {
+        state.visited[p >> 6] = 0;
+    }
+
+    // a node is an end once per accepting state it is reached in
+    std::sort(state.ends.begin(), state.ends.end());
+    state.ends.erase(std::unique(state.ends.begin(), state.ends.end()), state.ends.end());
+    for (auto v : state.ends) {
+        res.emplace_back(start, v);
+    }
+}
+
+void PathQuery::search(const TermId *sources, size_t count, BatchSearch &state, std::vector<NodePair> &res) const {
+    uint64_t states = dfa.size();
+    size_t pairs = graph.termCount() * states;
+    state.masks.resize(pairs);
+    state.found.resize(graph.termCount());
+    state.active.clear();
+    state.touched.clear();
+    state.ends.clear();
+
+    for (size_t i = 0; i < count; ++i) {
+        auto pair = sources[i] * states + dfa.start();
+        state.masks[pair].seen = state.masks[pair].visit[0] = uint64_t(1) << i;
+        state.active.push_back(pair);
+    }
+
+    for (int level = 0; !state.active.empty(); level ^= 1) {
+        state.activeNext.clear();
+
+        for (auto pair : state.active) {
+            TermId v = pair / states;
+            int32_t q = pair % states;
+            uint64_t mask = state.masks[pair].visit[level];
+            state.masks[pair].visit[level] = 0;
+            state.touched.push_back(pair);
+
+            if (dfa.accepting(q)) {
+                if (!state.found[v]) {
+                    state.ends.push_back(v);
+                }
+                state.found[v] |= mask;
+            }
+
+            // edges are grouped by predicate, step the automaton once per group
+            auto edges = graph.edges(v);
+            for (auto e = edges.begin(); e != edges.end(); ) {
+                auto predicate = e->predicate;
+                auto to = dfa.next(q, predicate);
+                if (to == dfa.dead()) {
+                    while (e != edges.end() && e->predicate == predicate) ++e;
+                    continue;
+                }
+
+                for (; e != edges.end() && e->predicate == predicate; ++e) {
+                    auto next = e->target * states + to;
+                    auto &m = state.masks[next];
+                    uint64_t fresh = mask & ~m.seen;
+                    if (!fresh) continue;
+
+                    m.seen |= fresh;
+                    if (!m.visit[level ^ 1]) {
+                        state.activeNext.push_back(next);
+                    }
+                    m.visit[level ^ 1] |= fresh;
+                }
+            }
+        }
+
+        state.active.swap(state.activeNext);
+    }
+
+    // sources are ascending, emitting source by source keeps res sorted
+    std::sort(state.ends.begin(), state.ends.end());
+    for (size_t i = 0; i < count; ++i) {
+        for (auto v : state.ends) {
+            if ((state.found[v] >> i) & 1) {
+                res.emplace_back(sources[i], v);
+            }
+        }
+    }
+    for (auto v : state.ends) {
+        state.found[v] = 0;
+    }
+
+    for (auto pair : state.touched) {
+        state.masks[pair].seen = 0;
+    }
+}
+
+void PathQuery::multiply(const TermId *sources, size_t count, MatrixSearch &state, std::vector<NodePair> &res) const {
+    uint64_t states = dfa.size();
+    size_t pairs = graph.termCount() * states;
+    if (state.reach.rows() != pairs) {
+        state.reach = state.delta = state.next = BitMatrix(pairs, MatrixBlock);
+        state.found = BitMatrix(graph.termCount(), MatrixBlock);
+        state.active.assign(states, {});
+        state.activeNext.assign(states, {});
+        state.queued.assign((pairs + 63) / 64, 0);
+    }
+    size_t words = state.reach.words();
+    state.touched.clear();
+
+    // the delta and reach rows of the start state
+    for (size_t i = 0; i < count; ++i) {
+        auto pair = sources[i] * states + dfa.start();
+        state.delta.set(pair, i);
+        state.reach.set(pair, i);
+        state.active[dfa.start()].push_back(sources[i]);
+        state.touched.push_back(sources[i]);
+    }
+
+    for (bool more = true; more; ) {
+        // next = sum over transitions q -p-> r of delta_q * A_p
+        for (int32_t q = 0; q < states; ++q) {
+            for (auto [p, r] : moves[q]) {
+                auto &a = adjacency[p];
+                for (auto v : state.active[q]) {
+                    auto src = state.delta.row(v * states + q);
+                    for (auto it = a.begin(v); it != a.end(v); ++it) {
+                        auto pair = *it * states + r;
+                        if (testAndSet(state.queued, pair)) {
+                            state.activeNext[r].push_back(*it);
+                        }
+                        BitMatrix::orRow(state.next.row(pair), src, words);
+                    }
+                }
+            }
+        }
+
+        // delta = next & ~reach, reach |= delta
+        more = false;
+        for (int32_t q = 0; q < states; ++q) {
+            for (auto v : state.active[q]) {
+                BitMatrix::clearRow(state.delta.row(v * states + q), words);
+            }
+            state.active[q].clear();
+
+            for (auto v : state.activeNext[q]) {
+                auto pair = v * states + q;
+                state.queued[pair >> 6] = 0;
+
+                auto next = state.next.row(pair);
+                auto reach = state.reach.row(pair);
+                if (BitMatrix::andNotRow(next, reach, words)) {
+                    BitMatrix::orRow(reach, next, words);
+                    BitMatrix::orRow(state.delta.row(pair), next, words);
+                    BitMatrix::clearRow(next, words);
+                    state.active[q].push_back(v);
+                    state.touched.push_back(v);
+                    more = true;
+                }
+            }
+            state.activeNext[q].clear();
+        }
+    }
+
+    std::sort(state.touched.begin(), state.touched.end());
+    state.touched.erase(std::unique(state.touched.begin(), state.touched.end()), state.touched.end());
+
+    // found = sum over accepting q of reach_q
+    for (auto v : state.touched) {
+        for (int32_t q = 0; q < states; ++q) {
+            auto reach = state.reach.row(v * states + q);
+            if (dfa.accepting(q)) {
+                BitMatrix::orRow(state.found.row(v), reach, words);
+            }
+            BitMatrix::clearRow(reach, words);
+        }
+    }
+
+    // sources are ascending, emitting source by source keeps res sorted
+    for (size_t i = 0; i < count; ++i) {
+        for (auto v : state.touched) {
+            if (state.found.get(v, i)) {
+                res.emplace_back(sources[i], v);
+            }
+        }
+    }
+    for (auto v : state.touched) {
+        BitMatrix::clearRow(state.found.row(v), words);
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "automaton.hpp"
+#include "csr.hpp"
+#include "matrix.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+using NodePair = std::pair<TermId, TermId>;
+
+enum class PathEngine {
+    // breadth-first search over the product graph
+    Traversal,
+    // boolean matrix products over one adjacency matrix per predicate
+    Matrix
+};
+
+/* Regular path query: every pair of nodes joined by a path whose
+ * predicates spell a word of a regular expression.
+ *
+ * Predicates are written as <term> in the expression, a plain
+ * character c names the predicate term "c". Evaluation is a
+ * breadth-first search over the product of the graph and the compiled
+ * automaton that visits every (node, state) pair at most once per
+ * start node; visited pairs are kept in a bitset.
+ *
+ * Several start nodes are evaluated together in the style of MS-BFS:
+ * batches of 64 sources share one traversal and every (node, state)
+ * pair carries a mask of the sources that reached it, so a pair
+ * reached by many sources is expanded once per level rather than
+ * once per source.
+ *
+ * A single start node can also be searched on several threads with a
+ * level-synchronous BFS. Frontier chunks are shared out with work
+ * stealing and (node, state) pairs are claimed in an atomic bitmap.
+ * Every level is expanded top-down from the frontier or bottom-up from
+ * the unvisited pairs, whichever touches fewer edges.
+ *
+ * The matrix engine evaluates the same product algebraically. The
+ * product graph has the adjacency matrix sum_p D_p (x) A_p, where D_p
+ * is the automaton transition matrix and A_p the graph adjacency for
+ * predicate p. Reachability from a block of 256 sources is a bit-packed
+ * matrix with one row per (node, state) pair, extended by sparse
+ * products with the A_p until no new bits appear.
+ */
+class PathQuery {
+public:
+    PathQuery(const CsrGraph &graph, const TermDictionaryView &terms, const std::string &regex,
+              PathEngine engine = PathEngine::Traversal);
+
+    // pairs for every start node, sorted
+    std::vector<NodePair> evaluate() const;
+    // pairs for a single start node, sorted
+    std::vector<NodePair> evaluate(TermId start) const;
+    // pairs for the given start nodes, sorted
+    std::vector<NodePair> evaluate(const std::vector<TermId> &starts) const;
+    // pairs for a single start node using the parallel traversal, sorted;
+    // threads == 0 means one thread per hardware core
+    std::vector<NodePair> evaluateParallel(TermId start, unsigned threads = 0) const;
+
+    const CompiledDFA &automaton() const;
+
+private:
+    // state kept between searches from different start nodes
+    struct Search {
+        std::vector<uint64_t> visited;
+        std::vector<uint64_t> queue;
+        std::vector<TermId> ends;
+    };
+
+    // source masks of a (node, state) pair, kept together so expanding
+    // a pair touches a single cache line
+    struct Masks {
+        uint64_t seen = 0;
+        // indexed by level parity, the current and the next frontier
+        uint64_t visit[2] = { 0, 0 };
+    };
+
+    // state of a multi-source search, pairs are indexed by node * states + state
+    struct BatchSearch {
+        std::vector<Masks> masks;
+        // reached ends per node
+        std::vector<uint64_t> found;
+        std::vector<uint64_t> active, activeNext, touched;
+        std::vector<TermId> ends;
+    };
+
+    // state of a matrix evaluation, rows are indexed by node * states + state
+    struct MatrixSearch {
+        BitMatrix reach, delta, next;
+        // reached ends per node
+        BitMatrix found;
+        // per state, nodes whose delta row is not zero
+        std::vector<std::vector<TermId>> active, activeNext;
+        std::vector<uint64_t> queued;
+        std::vector<TermId> touched;
+    };
+
+    static constexpr size_t MatrixBlock = 256;
+
+    void search(TermId start, Search &state, std::vector<NodePair> &res) const;
+    // at most 64 sources
+    void search(const TermId *sources, size_t count, BatchSearch &state, std::vector<NodePair> &res) const;
+    // at most MatrixBlock sources
+    void multiply(const TermId *sources, size_t count, MatrixSearch &state, std::vector<NodePair> &res) const;
+
+    const CsrGraph &graph;
+    CompiledDFA dfa;
+    PathEngine engine;
+    // matrix engine only: live transitions (predicate, target) per state
+    // and the adjacency matrices of the predicates they use
+    std::vector<std::vector<std::pair<uint32_t, int32_t>>> moves;
+    std::vector<SparseMatrix> adjacency;
+};
@@ -0,0 +1,190 @@
+#include "snapshot.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const char Magic[8] = { 'G', 'R', 'A', 'P', 'H', 'D', 'B', '\0' };
+const uint32_t ByteOrderMark = 0x01020304;
+
+uint64_t align(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+} // namespace
+
+SnapshotGraph::SnapshotGraph(const std::string &path) : file(path) {
+    Header h;
+    if (file.size() < sizeof(h)) {
+        throw std::runtime_error(path + ": not a graph snapshot");
+    }
+    std::memcpy(&h, file.data(), sizeof(h));
+
+    if (std::memcmp(h.magic, Magic, sizeof(Magic)) != 0) {
+        throw std::runtime_error(path + ": not a graph snapshot");
+    }
+    if (h.version != Version) {
+        throw std::runtime_error(path + ": unsupported snapshot version " + std::to_string(h.version));
+    }
+    if (h.byteOrder != ByteOrderMark) {
+        throw std::runtime_error(path + ": snapshot has foreign byte order");
+    }
+
+    // every check is phrased so that untrusted sizes cannot overflow
+    uint64_t size = file.size();
+    auto fits = [&](uint64_t at, uint64_t count, uint64_t width, uint64_t alignment) {
+        return at <= size && count <= (size - at) / width && at % alignment == 0;
+    };
+    bool valid = h.terms < TermDictionary::NoTerm &&
+                 fits(h.offsetsAt, h.terms, sizeof(uint64_t), 8) &&
+                 fits(h.offsetsAt + h.terms * sizeof(uint64_t), 1, sizeof(uint64_t), 8) &&
+                 fits(h.poolAt, h.poolSize, 1, 1) &&
+                 fits(h.slotsAt, h.slots, sizeof(TermId), alignof(TermId)) &&
+                 // a power of two with room for an empty slot
+                 h.slots > h.terms && (h.slots & (h.slots - 1)) == 0;
+    for (auto at : h.indexAt) {
+        valid = valid && fits(at, h.triples, sizeof(IdTriple), alignof(IdTriple));
+    }
+    if (!valid) {
+        throw std::runtime_error(path + ": truncated graph snapshot");
+    }
+
+    auto base = file.data();
+    dictionary = TermDictionaryView {
+        base + h.poolAt,
+        reinterpret_cast<const uint64_t*>(base + h.offsetsAt),
+        h.terms,
+        reinterpret_cast<const TermId*>(base + h.slotsAt),
+        h.slots
+    };
+    for (int i = 0; i < 3; ++i) {
+        indexes[i] = reinterpret_cast<const IdTriple*>(base + h.indexAt[i]);
+    }
+    count = h.triples;
+
+    // only the ends of the term bounds, the sections are scanned by verify()
+    if (dictionary.offsets[0] != 0 || dictionary.offsets[h.terms] > h.poolSize) {
+        throw std::runtime_error(path + ": corrupt graph snapshot");
+    }
+}
+
+void SnapshotGraph::verify() const {
+    auto &d = dictionary;
+    bool valid = true;
+    // term bounds ascend, the ends were checked on open
+    for (size_t i = 0; valid && i < d.count; ++i) {
+        valid = d.offsets[i + 1] >= d.offsets[i];
+    }
+
+    // probing stops at an empty slot, there has to be one
+    size_t empty = 0;
+    for (size_t i = 0; valid && i < d.slotCount; ++i) {
+        if (d.slots[i] == TermDictionary::NoTerm) {
+            ++empty;
+        } else {
+            valid = d.slots[i] < d.count;
+        }
+    }
+    valid = valid && empty > 0;
+
+    for (auto index : indexes) {
+        for (size_t i = 0; valid && i < count; ++i) {
+            auto &t = index[i];
+            valid = t.subject < d.count && t.predicate < d.count && t.object < d.count;
+        }
+    }
+    if (!valid) {
+        throw std::runtime_error("corrupt graph snapshot");
+    }
+}
+
+void SnapshotGraph::write(const DictionaryGraph &graph, const std::string &path) {
+    auto terms = graph.terms().view();
+    auto &index = graph.index();
+
+    Header h{};
+    std::memcpy(h.magic, Magic, sizeof(Magic));
+    h.version = Version;
+    h.byteOrder = ByteOrderMark;
+    h.terms = terms.size();
+    h.poolSize = terms.offsets[terms.size()];
+    h.slots = terms.slotCount;
+    h.triples = index.size();
+
+    h.offsetsAt = align(sizeof(h));
+    h.poolAt = h.offsetsAt + (h.terms + 1) * sizeof(uint64_t);
+    h.slotsAt = align(h.poolAt + h.poolSize);
+    uint64_t at = align(h.slotsAt + h.slots * sizeof(TermId));
+    for (auto &indexAt : h.indexAt) {
+        indexAt = at;
+        at = align(at + h.triples * sizeof(IdTriple));
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    auto section = [&](uint64_t offset, const void *data, uint64_t size) {
+        static const char zeros[8] = {};
+        out.write(zeros, offset - out.tellp());
+        out.write(static_cast<const char*>(data), size);
+    };
+
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    section(h.offsetsAt, terms.offsets, (h.terms + 1) * sizeof(uint64_t));
+    section(h.poolAt, terms.pool, h.poolSize);
+    section(h.slotsAt, terms.slots, h.slots * sizeof(TermId));
+    for (auto order : { IndexOrder::SPO, IndexOrder::POS, IndexOrder::OSP }) {
+        auto range = index.all(order);
+        section(h.indexAt[static_cast<int>(order)], range.first, range.size() * sizeof(IdTriple));
+    }
+
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+void SnapshotGraph::addTriple(const Triple &) {
+    throw std::logic_error("snapshot graphs are read-only");
+}
+
+void SnapshotGraph::addTriples(const TripleBuffer &) {
+    throw std::logic_error("snapshot graphs are read-only");
+}
+
+void SnapshotGraph::addStatement(std::string_view, std::string_view, std::string_view) {
+    throw std::logic_error("snapshot graphs are read-only");
+}
+
+bool SnapshotGraph::hasTriple(const Triple &triple) const {
+    IdTriple t;
+    if (!TriplePattern{triple.subject, triple.predicate, triple.object}.encode(dictionary, t)) {
+        return false;
+    }
+    return !matchIds(t).empty();
+}
+
+std::unique_ptr<TripleCursor> SnapshotGraph::match(const TriplePattern &pattern) const {
+    IdTriple t;
+    if (!pattern.encode(dictionary, t)) {
+        return std::make_unique<IdRangeCursor>(dictionary, IdRange{});
+    }
+    return std::make_unique<IdRangeCursor>(dictionary, matchIds(t));
+}
+
+IdRange SnapshotGraph::matchIds(const IdTriple &pattern) const {
+    auto order = TripleIndex::orderFor(pattern);
+    return TripleIndex::equalRange(order, all(order), pattern);
+}
+
+IdRange SnapshotGraph::all(IndexOrder order) const {
+    auto first = indexes[static_cast<int>(order)];
+    return { first, first + count };
+}
+
+const TermDictionaryView &SnapshotGraph::terms() const {
+    return dictionary;
+}
+
+size_t SnapshotGraph::size() const {
+    return count;
+}
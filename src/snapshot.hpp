@@ -0,0 +1,66 @@
+#pragma once
+
+#include "graph.hpp"
+#include "mmap.hpp"
+#include <string>
+
+/* Immutable graph backed by a memory-mapped binary snapshot.
+ *
+ * Opening a snapshot only validates its header, pages of the term
+ * dictionary and indexes are loaded lazily by the kernel and shared
+ * between all processes mapping the same file. Files from untrusted
+ * sources should be checked with verify() before they are queried.
+ *
+ * File layout (native byte order, sections aligned to 8 bytes):
+ *   header      SnapshotGraph::Header
+ *   offsets     uint64_t[terms + 1]
+ *   pool        char[poolSize]
+ *   slots       TermId[slots], dictionary hash table
+ *   spo/pos/osp IdTriple[triples] each
+ */
+class SnapshotGraph : public Graph {
+public:
+    static constexpr uint32_t Version = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t terms;
+        uint64_t poolSize;
+        uint64_t slots;
+        uint64_t triples;
+        // section offsets from the beginning of the file
+        uint64_t offsetsAt, poolAt, slotsAt, indexAt[3];
+    };
+
+    explicit SnapshotGraph(const std::string &path);
+
+    // scans every section and throws std::runtime_error unless term
+    // bounds ascend, the hash table holds only valid ids and an empty
+    // slot, and triples only valid ids; reads the whole file
+    void verify() const;
+
+    static void write(const DictionaryGraph &graph, const std::string &path);
+
+    // snapshots are read-only, these throw std::logic_error
+    void addTriple(const Triple &triple) override;
+    void addTriples(const TripleBuffer &buffer) override;
+    void addStatement(std::string_view subject, std::string_view predicate, std::string_view object) override;
+
+    bool hasTriple(const Triple &triple) const override;
+    std::unique_ptr<TripleCursor> match(const TriplePattern &pattern) const override;
+
+    // TermDictionary::NoTerm components of pattern act as wildcards
+    IdRange matchIds(const IdTriple &pattern) const;
+    IdRange all(IndexOrder order) const;
+
+    const TermDictionaryView &terms() const;
+    size_t size() const;
+
+private:
+    MappedFile file;
+    TermDictionaryView dictionary;
+    const IdTriple *indexes[3];
+    size_t count;
+};
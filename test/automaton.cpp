@@ -1,6 +1,10 @@
 #include "automaton.hpp"
 #include <catch.hpp>
 #include <algorithm>
+#include <functional>
+#include <random>
+#include <set>
+#include <thread>
 
 TEST_CASE( "Automaton from regex", "[regex]" ) {
     SECTION( "Regex: 0|1*" ) {
@@ -102,11 +106,41 @@ TEST_CASE( "Automaton from regex", "[regex]" ) {
         }
     }
 
+    SECTION( "Loops do not leak into alternatives" ) {
+        CHECK( !DFA::fromRegex("(a*|b)").accepts("ab") );
+        CHECK( !DFA::fromRegex("((a)*ca|)").accepts("aaa") );
+        CHECK( DFA::fromRegex("((a)*ca|)").accepts("aaca") );
+        CHECK( !DFA::fromRegex("(b*ca)*").accepts("b") );
+    }
+
     SECTION( "Invalid regexes" ) {
         CHECK_THROWS_AS(NFA::fromRegex("("), ParseException);
         CHECK_THROWS_AS(NFA::fromRegex(")"), ParseException);
         CHECK_THROWS_AS(NFA::fromRegex("*b"), ParseException);
         CHECK_THROWS_AS(NFA::fromRegex("|"), ParseException);
+        CHECK_THROWS_AS(NFA::fromRegex("a**"), ParseException);
+        CHECK_THROWS_AS(NFA::fromRegex("a||b"), ParseException);
+        CHECK_THROWS_AS(NFA::fromRegex("(|a)"), ParseException);
+        CHECK_THROWS_AS(NFA::fromRegex("((a)"), ParseException);
+    }
+
+    SECTION( "Long and deeply nested regexes" ) {
+        // 20000 named symbols, parsed without recursion
+        std::string regex = "(";
+        for (int i = 0; i < 20000; ++i) {
+            regex += (i ? "|<" : "<") + std::to_string(i) + ">";
+        }
+        regex += ")*";
+        auto dfa = DFA::fromRegex(regex, [](const std::string &name) {
+            return std::stoi(name);
+        });
+        CHECK( dfa.size() == 1 );
+        CHECK( dfa.accepts("") );
+
+        std::string nested = std::string(100000, '(') + "ab" + std::string(100000, ')') + "*";
+        auto deep = DFA::fromRegex(nested);
+        CHECK( deep.accepts("abab") );
+        CHECK( !deep.accepts("aba") );
     }
 }
 
@@ -164,3 +198,414 @@ TEST_CASE("DFA intersection", "[dfa_intersection]") {
         }
     }
 }
+
+TEST_CASE("Compiled DFA", "[compiled_dfa]") {
+    auto regex = GENERATE(as<std::string>{},
+        "0|1*", "(0|(1(01*0)*1))*", "", "ab*(c|)", "(a|b)*abb", "((ab)*|c)*d");
+    auto dfa = DFA::fromRegex(regex);
+    CompiledDFA compiled{dfa};
+
+    CHECK( compiled.size() == dfa.size() + 1 );
+    CHECK( !compiled.accepting(compiled.dead()) );
+
+    std::string alphabet = "01abcd";
+    std::vector<std::string> words;
+    for (int len = 0; len <= 6; ++len) {
+        int total = 1;
+        for (int i = 0; i < len; ++i) total *= alphabet.size();
+
+        for (int code = 0; code < total; ++code) {
+            std::string s;
+            for (int i = 0, c = code; i < len; ++i, c /= alphabet.size()) {
+                s.push_back(alphabet[c % alphabet.size()]);
+            }
+            REQUIRE( compiled.accepts(s) == dfa.accepts(s) );
+            words.push_back(s);
+        }
+    }
+
+    CHECK( !compiled.accepts("\xff") );
+
+    SECTION( "batches" ) {
+        // long words keep lanes busy while short ones come and go
+        std::mt19937 rng(regex.size());
+        for (int i = 0; i < 1000; ++i) {
+            std::string s;
+            for (int len = rng() % 200; len > 0; --len) {
+                s.push_back(alphabet[rng() % 3]);
+            }
+            words.push_back(s);
+        }
+        std::shuffle(words.begin(), words.end(), rng);
+
+        for (size_t count : { size_t(0), size_t(1), size_t(7), size_t(9), words.size() }) {
+            std::vector<std::string_view> batch(words.begin(), words.begin() + count);
+            std::vector<char> res(count, 2);
+            compiled.accepts(batch.data(), count, res.data());
+            for (size_t i = 0; i < count; ++i) {
+                REQUIRE( res[i] == dfa.accepts(words[i]) );
+            }
+        }
+    }
+}
+
+TEST_CASE("Lazy intersection", "[dfa_intersection]") {
+    SECTION( "emptiness check" ) {
+        auto div3 = DFA::fromRegex("(0|(1(01*0)*1))*");
+        CHECK( div3.intersects(DFA::fromRegex("(0|1)*0")) );
+        CHECK( div3.intersects(DFA::fromRegex("11(0|1)*")) );
+        CHECK( !div3.intersects(DFA::fromRegex("1")) );
+        CHECK( !DFA::fromRegex("a*").intersects(DFA::fromRegex("b(a|b)*")) );
+        CHECK( DFA::fromRegex("a*").intersects(DFA::fromRegex("b*")) );
+    }
+
+    SECTION( "agrees with both operands" ) {
+        auto seed = GENERATE(take(10, random(0, 1000000)));
+        std::mt19937 rng(seed);
+
+        auto randomDFA = [&](int n) {
+            DFA dfa;
+            for (int i = 0; i < n; ++i) {
+                dfa.addState(rng() % 3 == 0);
+            }
+            for (int i = 0; i < n; ++i) {
+                for (char ch : std::string("ab")) {
+                    if (rng() % 5 != 0) {
+                        dfa.addTransition(i, ch, rng() % n);
+                    }
+                }
+            }
+            return dfa;
+        };
+
+        auto a = randomDFA(40), b = randomDFA(40);
+        auto both = a;
+        both.intersect(b);
+
+        bool any = false;
+        for (int i = 0; i < 500; ++i) {
+            std::string s;
+            for (int len = rng() % 12; len > 0; --len) {
+                s.push_back("ab"[rng() % 2]);
+            }
+            bool expected = a.accepts(s) && b.accepts(s);
+            any |= expected;
+            REQUIRE( both.accepts(s) == expected );
+        }
+        if (any) {
+            CHECK( a.intersects(b) );
+        }
+        CHECK( a.intersects(b) == b.intersects(a) );
+    }
+}
+
+TEST_CASE("Symbol classes", "[symbol_classes]") {
+    SECTION( "symbols used identically share a class" ) {
+        auto dfa = DFA::fromRegex("(a|b|c)*d(a|b|c)");
+        auto classes = dfa.symbolClasses();
+
+        CHECK( classes.count() == 3 );
+        CHECK( classes.classOf('a') == classes.classOf('b') );
+        CHECK( classes.classOf('a') == classes.classOf('c') );
+        CHECK( classes.classOf('a') != classes.classOf('d') );
+        CHECK( classes.classOf('e') == 0 );
+        CHECK( classes.classOf(-5) == 0 );
+        CHECK( classes.members(classes.classOf('b')) == std::vector<int>{'a', 'b', 'c'} );
+
+        CompiledDFA compiled{dfa};
+        CHECK( compiled.classCount() == 3 );
+        CHECK( compiled.accepts("abcdc") );
+        CHECK( !compiled.accepts("abcd") );
+    }
+
+    SECTION( "determinized NFA classes" ) {
+        auto dfa = NFA::fromRegex("(0|1|2|3|4|5|6|7|8|9)*x").determinize();
+        CHECK( dfa.symbolClasses().count() == 3 );
+        CHECK( CompiledDFA{dfa}.classCount() == 3 );
+        CHECK( dfa.size() == 2 );
+        CHECK( dfa.accepts("0123456789x") );
+        CHECK( !dfa.accepts("0123456789") );
+    }
+
+    SECTION( "intersection refines both alphabets" ) {
+        auto a = DFA::fromRegex("(a|b|c)*").symbolClasses();
+        auto b = DFA::fromRegex("(b|c|d)*c").symbolClasses();
+        auto joint = SymbolClasses::intersect(a, b);
+
+        CHECK( joint.classOf('a') == 0 );
+        CHECK( joint.classOf('d') == 0 );
+        CHECK( joint.classOf('b') != 0 );
+        CHECK( joint.classOf('b') != joint.classOf('c') );
+
+        auto dfa = DFA::fromRegex("(a|b|c)*");
+        dfa.intersect(DFA::fromRegex("(b|c|d)*c"));
+        CHECK( dfa.accepts("bbc") );
+        CHECK( !dfa.accepts("abc") );
+        CHECK( !dfa.accepts("dc") );
+    }
+}
+
+TEST_CASE("DFA minimization", "[minimize]") {
+    SECTION( "random automata" ) {
+        auto seed = GENERATE(take(20, random(0, 1000000)));
+        std::mt19937 rng(seed);
+
+        DFA dfa;
+        int n = 2 + rng() % 60;
+        for (int i = 0; i < n; ++i) {
+            dfa.addState(rng() % 3 == 0);
+        }
+        for (int i = 0; i < n; ++i) {
+            for (char ch : std::string("abc")) {
+                if (rng() % 4 != 0) {
+                    dfa.addTransition(i, ch, rng() % n);
+                }
+            }
+        }
+
+        auto minimal = dfa;
+        minimal.minimize();
+        CHECK( minimal.size() <= dfa.size() );
+
+        auto again = minimal;
+        again.minimize();
+        CHECK( again.size() == minimal.size() );
+
+        for (int i = 0; i < 500; ++i) {
+            std::string s;
+            for (int len = rng() % 12; len > 0; --len) {
+                s.push_back("abcd"[rng() % 4]);
+            }
+            REQUIRE( minimal.accepts(s) == dfa.accepts(s) );
+        }
+    }
+
+    SECTION( "equivalent and dead states collapse" ) {
+        // (a|b)c, spelled out with duplicated and useless states
+        DFA dfa;
+        int start = dfa.addState();
+        int a = dfa.addState();
+        int b = dfa.addState();
+        int end = dfa.addState(true);
+        int trap = dfa.addState();
+        dfa.addTransition(start, 'a', a);
+        dfa.addTransition(start, 'b', b);
+        dfa.addTransition(start, 'x', trap);
+        dfa.addTransition(a, 'c', end);
+        dfa.addTransition(b, 'c', end);
+        dfa.addTransition(trap, 'x', trap);
+
+        dfa.minimize();
+        CHECK( dfa.size() == 3 );
+        CHECK( dfa.accepts("ac") );
+        CHECK( dfa.accepts("bc") );
+        CHECK( !dfa.accepts("xc") );
+    }
+}
+
+TEST_CASE("DFA builder", "[dfa_builder]") {
+    SECTION( "transitions in any order" ) {
+        // states are filled in random order and transitions overwritten,
+        // which moves runs around the arena; compare with a plain table
+        auto seed = GENERATE(take(20, random(0, 1000000)));
+        std::mt19937 rng(seed);
+        int n = 2 + rng() % 30;
+
+        DFA dfa;
+        std::vector<std::map<int, int>> reference(n);
+        std::vector<bool> term(n);
+        for (int i = 0; i < n; ++i) {
+            term[i] = rng() % 3 == 0;
+            dfa.addState(term[i]);
+        }
+        for (int i = 0; i < 20 * n; ++i) {
+            int from = rng() % n, ch = 'a' + rng() % 4, to = rng() % n;
+            dfa.addTransition(from, ch, to);
+            reference[from][ch] = to;
+        }
+
+        auto copy = dfa;
+        copy.addTransition(0, 'z', 0);
+        CHECK( !dfa.accepts("z") );
+
+        for (int k = 0; k < 200; ++k) {
+            std::string s;
+            int state = 0;
+            for (int len = rng() % 10; len > 0 && state != -1; --len) {
+                char ch = 'a' + rng() % 4;
+                s += ch;
+                auto it = reference[state].find(ch);
+                state = it == reference[state].end() ? -1 : it->second;
+            }
+            bool expected = state != -1 && term[state];
+            REQUIRE( dfa.accepts(s) == expected );
+            REQUIRE( copy.accepts(s) == expected );
+        }
+    }
+}
+
+TEST_CASE("DFA cache", "[dfa_cache]") {
+    SECTION( "hits, misses and evictions" ) {
+        DFACache cache(2);
+        auto a = DFA::fromRegex("(ab)*", cache);
+        CHECK( a->accepts("abab") );
+        CHECK( !a->accepts("aba") );
+        // the same automaton, not a copy
+        CHECK( DFA::fromRegex("(ab)*", cache) == a );
+        CHECK( cache.get("((ab)*)") == a );
+
+        auto b = cache.get("a|b");
+        auto c = cache.get("c");
+        auto stats = cache.stats();
+        CHECK( stats.hits == 2 );
+        CHECK( stats.misses == 3 );
+        CHECK( stats.evictions == 1 );
+        CHECK( stats.size == 2 );
+
+        // (ab)* was least recently used, evicting it keeps it alive
+        CHECK( a->accepts("ab") );
+        CHECK( cache.get("(ab)*") != a );
+        CHECK( cache.get("c") == c );
+        CHECK( cache.get("a|b") != b );
+        CHECK( cache.stats().evictions == 3 );
+    }
+
+    SECTION( "normalization" ) {
+        CHECK( DFACache::normalize("((a|b))") == "a|b" );
+        CHECK( DFACache::normalize("(a)(b)") == "(a)(b)" );
+        CHECK( DFACache::normalize("(a)*") == "(a)*" );
+        CHECK( DFACache::normalize("()") == "" );
+        CHECK( DFACache::normalize("((a)") == "((a)" );
+        CHECK( DFACache::normalize("(<)>)", true) == "<)>" );
+        CHECK( DFACache::normalize("(<)>)") == "(<)>)" );
+    }
+
+    SECTION( "invalid regexes are not cached" ) {
+        DFACache cache;
+        CHECK_THROWS_AS( cache.get("(a|"), ParseException );
+        CHECK_THROWS_AS( cache.get("(a**)"), ParseException );
+        CHECK( cache.stats().size == 0 );
+    }
+
+    SECTION( "symbol names" ) {
+        DFACache cache(16, [](const std::string &name) {
+            return name == "knows" ? 'k' : name == "likes" ? 'l' : 'x';
+        });
+        auto dfa = cache.get("(<knows>|<likes>)*");
+        CHECK( dfa->accepts("klk") );
+        CHECK( !dfa->accepts("kx") );
+    }
+
+    SECTION( "concurrent lookups" ) {
+        DFACache cache(8);
+        std::vector<std::string> regexes;
+        for (int i = 0; i < 16; ++i) {
+            regexes.push_back("(a|b)*" + std::string(i, 'a') + "b");
+        }
+
+        std::vector<std::thread> threads;
+        std::vector<int> wrong(4, 0);
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937 rng(t);
+                for (int k = 0; k < 500; ++k) {
+                    int i = rng() % regexes.size();
+                    auto dfa = cache.get(regexes[i]);
+                    wrong[t] += !dfa->accepts("ba" + std::string(i, 'a') + "b") ||
+                                dfa->accepts(std::string(i, 'a'));
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        CHECK( wrong == std::vector<int>(4, 0) );
+        auto stats = cache.stats();
+        CHECK( stats.hits + stats.misses == 2000 );
+        CHECK( stats.size == 8 );
+        // threads missing on the same regex at once all count a miss
+        CHECK( stats.evictions <= stats.misses - 8 );
+    }
+}
+
+TEST_CASE("Determinization against a reference matcher", "[determinize]") {
+    auto seed = GENERATE(take(50, random(0, 1000000)));
+    std::mt19937 rng(seed);
+
+    // random regex over {a, b, c} in the supported syntax, together with
+    // a matcher returning every end position of a match starting at i
+    using Ends = std::set<int>;
+    using Matcher = std::function<Ends(const std::string&, int)>;
+    std::function<std::pair<std::string, Matcher>(int)> gen = [&](int depth) {
+        std::pair<std::string, Matcher> res;
+        switch (depth > 0 ? rng() % 5 : 0) {
+            case 0: {
+                char ch = "abc"[rng() % 3];
+                res.first = std::string(1, ch);
+                res.second = [ch](const std::string &s, int i) {
+                    return i < s.size() && s[i] == ch ? Ends{i + 1} : Ends{};
+                };
+                break;
+            }
+            case 1: {
+                auto [x, mx] = gen(depth - 1);
+                auto [y, my] = gen(depth - 1);
+                res.first = x + y;
+                res.second = [mx = mx, my = my](const std::string &s, int i) {
+                    Ends ends;
+                    for (int j : mx(s, i)) {
+                        auto e = my(s, j);
+                        ends.insert(e.begin(), e.end());
+                    }
+                    return ends;
+                };
+                break;
+            }
+            case 2:
+            case 4: {
+                // case 4 is an alternative with the empty word
+                auto [x, mx] = gen(depth - 1);
+                auto [y, my] = gen(depth - 1);
+                bool empty = rng() % 2;
+                res.first = "(" + x + "|" + (empty ? "" : y) + ")";
+                res.second = [mx = mx, my = my, empty](const std::string &s, int i) {
+                    auto ends = mx(s, i);
+                    auto e = empty ? Ends{i} : my(s, i);
+                    ends.insert(e.begin(), e.end());
+                    return ends;
+                };
+                break;
+            }
+            default: {
+                auto [x, mx] = gen(depth - 1);
+                res.first = "(" + x + ")*";
+                res.second = [mx = mx](const std::string &s, int i) {
+                    Ends ends{i};
+                    std::vector<int> queue{i};
+                    while (!queue.empty()) {
+                        int j = queue.back();
+                        queue.pop_back();
+                        for (int k : mx(s, j)) {
+                            if (ends.insert(k).second) queue.push_back(k);
+                        }
+                    }
+                    return ends;
+                };
+            }
+        }
+        return res;
+    };
+
+    auto [regex, matcher] = gen(5);
+    auto dfa = DFA::fromRegex(regex);
+
+    for (int i = 0; i < 200; ++i) {
+        std::string s;
+        for (int len = rng() % 10; len > 0; --len) {
+            s.push_back("abc"[rng() % 3]);
+        }
+        INFO( "regex " << regex << ", input " << s );
+        REQUIRE( dfa.accepts(s) == matcher(s, 0).count(s.size()) );
+    }
+}
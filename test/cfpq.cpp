@@ -0,0 +1,123 @@
+#include <catch.hpp>
+#include "cfpq.hpp"
+#include <random>
+#include <set>
+
+namespace {
+
+using Pairs = std::set<std::pair<std::string, std::string>>;
+
+Pairs run(const DictionaryGraph &graph, const std::string &grammar, const std::string &start = "") {
+    CsrGraph csr(graph);
+    ContextFreeQuery query(csr, graph.terms().view(), Grammar::fromString(grammar));
+    auto pairs = start.empty() ? query.evaluate() : query.evaluate(graph.terms().find(start));
+
+    Pairs res;
+    for (auto [s, e] : pairs) {
+        res.emplace(graph.terms().term(s), graph.terms().term(e));
+    }
+    return res;
+}
+
+} // namespace
+
+TEST_CASE( "Grammars", "[cfpq]" ) {
+    auto grammar = Grammar::fromString(
+        "# same generation\n"
+        "S -> <sc> S <^sc>\n"
+        "\n"
+        "S -> <sc> <^sc>\n"
+        "<Other name> -> a*\n"
+    );
+
+    CHECK( grammar.start() == "S" );
+    CHECK( grammar.nonterminals() == std::vector<std::string>{ "S", "Other name" } );
+    CHECK( grammar.body("S") == "(<sc>S<^sc>)|(<sc><^sc>)" );
+    CHECK( grammar.body("Other name") == "(a*)" );
+
+    CHECK_THROWS_AS( Grammar::fromString(""), ParseException );
+    CHECK_THROWS_AS( Grammar::fromString("S a b"), ParseException );
+    CHECK_THROWS_AS( Grammar::fromString(" -> a"), ParseException );
+}
+
+TEST_CASE( "Context-free path queries", "[cfpq]" ) {
+    // class hierarchy, two levels below a
+    DictionaryGraph graph;
+    graph.addTriple({ "b", "sc", "a" });
+    graph.addTriple({ "c", "sc", "a" });
+    graph.addTriple({ "d", "sc", "b" });
+    graph.addTriple({ "e", "sc", "c" });
+    graph.addTriple({ "f", "type", "d" });
+
+    SECTION( "same generation" ) {
+        auto sameGeneration = "S -> <sc> S <^sc> | <sc> <^sc>";
+        CHECK( run(graph, sameGeneration) == Pairs{
+            { "b", "b" }, { "b", "c" }, { "c", "b" }, { "c", "c" },
+            { "d", "d" }, { "d", "e" }, { "e", "d" }, { "e", "e" },
+        } );
+        CHECK( run(graph, sameGeneration, "d") == Pairs{ { "d", "d" }, { "d", "e" } } );
+        CHECK( run(graph, sameGeneration, "a").empty() );
+    }
+
+    SECTION( "several nonterminals" ) {
+        auto grammar =
+            "S -> <type> <Up>\n"
+            "<Up> -> <sc> <Up> | <sc>\n";
+        CHECK( run(graph, grammar) == Pairs{ { "f", "b" }, { "f", "a" } } );
+    }
+
+    SECTION( "regular grammars match path queries" ) {
+        CsrGraph csr(graph);
+        PathQuery rpq(csr, graph.terms().view(), "<type>*<sc><sc>*");
+        ContextFreeQuery cfpq(csr, graph.terms().view(), Grammar::fromString("S -> <type>*<sc><sc>*"));
+        CHECK( cfpq.evaluate() == rpq.evaluate() );
+        CHECK( run(graph, "S -> ").size() == 6 );
+        CHECK( run(graph, "S -> <unknown> | <^unknown>").empty() );
+    }
+}
+
+TEST_CASE( "Context-free path queries against a fixpoint", "[cfpq]" ) {
+    auto seed = GENERATE(take(20, random(0, 1000000)));
+    std::mt19937 rng(seed);
+
+    // random graph over nodes 0..9 with predicates a and b
+    const int n = 10;
+    using Relation = std::set<std::pair<int, int>>;
+    Relation a, b;
+    DictionaryGraph graph;
+    for (int i = 0; i < 20; ++i) {
+        int s = rng() % n, o = rng() % n;
+        bool isA = rng() % 2;
+        (isA ? a : b).emplace(s, o);
+        graph.addTriple({ "n" + std::to_string(s), isA ? "a" : "b", "n" + std::to_string(o) });
+    }
+
+    auto compose = [](const Relation &x, const Relation &y) {
+        Relation res;
+        for (auto [s, m] : x) {
+            for (auto [m2, o] : y) {
+                if (m == m2) res.emplace(s, o);
+            }
+        }
+        return res;
+    };
+
+    // S -> a S b | a b, solved by iterating S = a b | a S b
+    Relation expected = compose(a, b);
+    for (bool changed = true; changed; ) {
+        auto next = compose(compose(a, expected), b);
+        changed = false;
+        for (auto p : next) {
+            changed |= expected.insert(p).second;
+        }
+    }
+
+    Pairs names;
+    for (auto [s, o] : expected) {
+        names.emplace("n" + std::to_string(s), "n" + std::to_string(o));
+    }
+
+    CHECK( run(graph, "S -> aSb | ab") == names );
+    // the same language through a helper nonterminal
+    CHECK( run(graph, "S -> a T\nT -> S b | b") == names );
+}
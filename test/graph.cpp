@@ -0,0 +1,505 @@
+#include <catch.hpp>
+#include "graph.hpp"
+#include "snapshot.hpp"
+#include "csr.hpp"
+#include "bulk.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <tuple>
+
+TEST_CASE( "Term dictionary", "[dictionary]" ) {
+    TermDictionary dict;
+
+    auto a = dict.intern("ex:Picasso");
+    auto b = dict.intern("foaf:firstName");
+    auto c = dict.intern("Pablo");
+
+    SECTION( "ids are dense and stable" ) {
+        CHECK( a == 0 );
+        CHECK( b == 1 );
+        CHECK( c == 2 );
+        CHECK( dict.intern("foaf:firstName") == b );
+        CHECK( dict.size() == 3 );
+    }
+
+    SECTION( "bidirectional lookup" ) {
+        CHECK( dict.term(a) == "ex:Picasso" );
+        CHECK( dict.term(c) == "Pablo" );
+        CHECK( dict.find("Pablo") == c );
+        CHECK( dict.find("Vincent") == TermDictionary::NoTerm );
+        CHECK( dict.find("") == TermDictionary::NoTerm );
+    }
+
+    SECTION( "survives growth" ) {
+        for (int i = 0; i < 10000; ++i) {
+            dict.intern("term" + std::to_string(i));
+        }
+        CHECK( dict.size() == 10003 );
+        for (int i = 0; i < 10000; ++i) {
+            auto id = dict.find("term" + std::to_string(i));
+            REQUIRE( id == TermId(i + 3) );
+            REQUIRE( dict.term(id) == "term" + std::to_string(i) );
+        }
+        CHECK( dict.find("ex:Picasso") == a );
+    }
+}
+
+TEST_CASE( "Dictionary-encoded graph", "[graph]" ) {
+    DictionaryGraph graph;
+    graph.addTriple({ "ex:Picasso", "foaf:firstName", "Pablo" });
+    graph.addTriple({ "ex:Picasso", "ex:creatorOf", "ex:guernica" });
+    graph.addTriple({ "ex:guernica", "rdfs:label", "Guernica" });
+
+    CHECK( graph.size() == 3 );
+    CHECK( graph.terms().size() == 7 );
+
+    CHECK( graph.hasTriple({ "ex:Picasso", "foaf:firstName", "Pablo" }) );
+    CHECK( graph.hasTriple({ "ex:guernica", "rdfs:label", "Guernica" }) );
+    CHECK( !graph.hasTriple({ "ex:Picasso", "foaf:firstName", "Guernica" }) );
+    CHECK( !graph.hasTriple({ "ex:VanGogh", "foaf:firstName", "Vincent" }) );
+
+    CHECK( graph.decode(graph.triples()[1]) ==
+           Triple{ "ex:Picasso", "ex:creatorOf", "ex:guernica" } );
+}
+
+TEST_CASE( "Triple pattern matching", "[graph]" ) {
+    const std::vector<Triple> triples = {
+        { "ex:Picasso", "foaf:surname", "Picasso" },
+        { "ex:Picasso", "ex:creatorOf", "ex:guernica" },
+        { "ex:VanGogh", "foaf:surname", "van Gogh" },
+        { "ex:VanGogh", "ex:creatorOf", "ex:starryNight" },
+        { "ex:VanGogh", "ex:creatorOf", "ex:sunflowers" },
+        { "ex:guernica", "rdfs:label", "Guernica" },
+        { "ex:sunflowers", "rdfs:label", "Sunflowers" },
+    };
+
+    TripleListGraph list;
+    DictionaryGraph dict;
+    for (auto &t : triples) {
+        list.addTriple(t);
+        dict.addTriple(t);
+    }
+
+    auto collect = [](const Graph &graph, const TriplePattern &pattern) {
+        std::vector<Triple> res;
+        Triple t;
+        auto cursor = graph.match(pattern);
+        while (cursor->next(t)) {
+            res.push_back(t);
+        }
+        std::sort(res.begin(), res.end(), [](const Triple &a, const Triple &b) {
+            return std::tie(a.subject, a.predicate, a.object) <
+                   std::tie(b.subject, b.predicate, b.object);
+        });
+        return res;
+    };
+
+    // every combination of bound and free components
+    for (int mask = 0; mask < 8; ++mask) {
+        for (auto &t : triples) {
+            TriplePattern pattern;
+            if (mask & 1) pattern.subject = t.subject;
+            if (mask & 2) pattern.predicate = t.predicate;
+            if (mask & 4) pattern.object = t.object;
+
+            auto expected = collect(list, pattern);
+            REQUIRE( !expected.empty() );
+            REQUIRE( collect(dict, pattern) == expected );
+        }
+    }
+
+    SECTION( "wildcards" ) {
+        CHECK( collect(dict, { {}, "foaf:surname", {} }).size() == 2 );
+        CHECK( collect(dict, { "ex:VanGogh", "ex:creatorOf", {} }).size() == 2 );
+        CHECK( collect(dict, { {}, {}, "Guernica" }).size() == 1 );
+        CHECK( collect(dict, { {}, {}, {} }).size() == triples.size() );
+    }
+
+    SECTION( "unknown terms" ) {
+        CHECK( collect(dict, { "ex:Monet", {}, {} }).empty() );
+        CHECK( collect(dict, { {}, "ex:creatorOf", "ex:waterLilies" }).empty() );
+    }
+
+    SECTION( "inserts after a query are visible" ) {
+        dict.addTriple({ "ex:Monet", "ex:creatorOf", "ex:waterLilies" });
+        CHECK( collect(dict, { {}, "ex:creatorOf", {} }).size() == 4 );
+        CHECK( dict.hasTriple({ "ex:Monet", "ex:creatorOf", "ex:waterLilies" }) );
+    }
+}
+
+TEST_CASE( "Triple set semantics", "[graph]" ) {
+    SECTION( "hash set" ) {
+        TripleSet set;
+        for (TermId i = 0; i < 5000; ++i) {
+            REQUIRE( set.insert({ i, i % 7, i * 31 }) );
+        }
+        for (TermId i = 0; i < 5000; ++i) {
+            REQUIRE( !set.insert({ i, i % 7, i * 31 }) );
+            REQUIRE( set.contains({ i, i % 7, i * 31 }) );
+            REQUIRE( !set.contains({ i, i % 7 + 1, i * 31 }) );
+        }
+        CHECK( set.size() == 5000 );
+    }
+
+    SECTION( "duplicates are dropped on insertion" ) {
+        DictionaryGraph graph;
+        for (int round = 0; round < 3; ++round) {
+            graph.addTriple({ "ex:Picasso", "foaf:surname", "Picasso" });
+            graph.addTriple({ "ex:VanGogh", "foaf:surname", "van Gogh" });
+        }
+        CHECK( graph.size() == 2 );
+        CHECK( graph.hasTriple({ "ex:VanGogh", "foaf:surname", "van Gogh" }) );
+        CHECK( graph.matchIds({ TermDictionary::NoTerm,
+                                graph.terms().find("foaf:surname"),
+                                TermDictionary::NoTerm }).size() == 2 );
+    }
+}
+
+TEST_CASE( "Bulk loading", "[graph][bulk]" ) {
+    std::mt19937 rng(GENERATE(take(2, random(0, 1000000))));
+    std::vector<Triple> triples;
+    for (int i = 0; i < 20000; ++i) {
+        // small vocabularies, so many triples are duplicates
+        triples.push_back({
+            "ex:s" + std::to_string(rng() % 500),
+            "ex:p" + std::to_string(rng() % 8),
+            "ex:o" + std::to_string(rng() % 500)
+        });
+    }
+
+    DictionaryGraph incremental;
+    for (auto &t : triples) {
+        incremental.addTriple(t);
+    }
+
+    auto same = [](const DictionaryGraph &a, const DictionaryGraph &b) {
+        if (a.size() != b.size() || a.terms().size() != b.terms().size()) {
+            return false;
+        }
+        for (TermId id = 0; id < a.terms().size(); ++id) {
+            if (a.terms().term(id) != b.terms().term(id)) return false;
+        }
+        for (auto order : { IndexOrder::SPO, IndexOrder::POS, IndexOrder::OSP }) {
+            auto x = a.index().all(order), y = b.index().all(order);
+            if (!std::equal(x.begin(), x.end(), y.begin(), y.end())) return false;
+        }
+        return true;
+    };
+
+    SECTION( "in memory" ) {
+        DictionaryGraph graph;
+        BulkLoader loader(graph);
+        for (auto &t : triples) {
+            loader.addTriple(t);
+        }
+        CHECK( graph.size() == 0 );
+        loader.finish();
+        CHECK( loader.spilledRuns() == 0 );
+        CHECK( same(graph, incremental) );
+        CHECK( std::is_sorted(graph.triples().begin(), graph.triples().end(), [](auto &x, auto &y) {
+            return std::tie(x.subject, x.predicate, x.object) < std::tie(y.subject, y.predicate, y.object);
+        }) );
+        CHECK( graph.hasTriple(triples[123]) );
+        CHECK( loader.hasTriple(triples[123]) );
+    }
+
+    SECTION( "spilled runs" ) {
+        DictionaryGraph graph;
+        BulkLoadOptions options;
+        // 1000 triples per run
+        options.memoryBudget = 1000 * 2 * sizeof(IdTriple);
+        options.threads = 3;
+        BulkLoader loader(graph, options);
+
+        TripleBuffer buffer;
+        for (auto &t : triples) {
+            buffer.add(t.subject, t.predicate, t.object);
+            if (buffer.triples.size() == 777) {
+                loader.addTriples(buffer);
+                buffer.clear();
+            }
+        }
+        loader.addTriples(buffer);
+        CHECK( loader.spilledRuns() == 20 );
+        loader.finish();
+        CHECK( loader.spilledRuns() == 0 );
+        CHECK( same(graph, incremental) );
+    }
+
+    SECTION( "into a graph with triples" ) {
+        DictionaryGraph graph;
+        for (size_t i = 0; i < triples.size() / 2; ++i) {
+            graph.addTriple(triples[i]);
+        }
+        graph.index();
+        // not indexed yet when the bulk load finishes
+        graph.addTriple(triples[triples.size() / 2]);
+
+        BulkLoadOptions options;
+        options.memoryBudget = 5000 * 2 * sizeof(IdTriple);
+        BulkLoader loader(graph, options);
+        for (size_t i = triples.size() / 4; i < triples.size(); ++i) {
+            loader.addTriple(triples[i]);
+        }
+        loader.finish();
+        CHECK( same(graph, incremental) );
+
+        // a second round only adds what is new
+        loader.addTriple(triples[0]);
+        loader.addTriple({ "ex:Monet", "ex:creatorOf", "ex:waterLilies" });
+        loader.finish();
+        CHECK( graph.size() == incremental.size() + 1 );
+        CHECK( graph.hasTriple({ "ex:Monet", "ex:creatorOf", "ex:waterLilies" }) );
+        CHECK( graph.matchIds({ graph.terms().find("ex:Monet"),
+                                TermDictionary::NoTerm,
+                                TermDictionary::NoTerm }).size() == 1 );
+    }
+}
+
+TEST_CASE( "Binary snapshots", "[snapshot]" ) {
+    DictionaryGraph graph;
+    for (int i = 0; i < 1000; ++i) {
+        auto n = std::to_string(i);
+        graph.addTriple({ "ex:n" + n, "ex:next", "ex:n" + std::to_string(i + 1) });
+        graph.addTriple({ "ex:n" + n, "rdfs:label", "node " + n });
+    }
+
+    auto path = "graphdb-test.snapshot";
+    SnapshotGraph::write(graph, path);
+    SnapshotGraph snapshot{path};
+
+    SECTION( "contents" ) {
+        CHECK( snapshot.size() == graph.size() );
+        CHECK( snapshot.terms().size() == graph.terms().size() );
+        CHECK( snapshot.hasTriple({ "ex:n41", "ex:next", "ex:n42" }) );
+        CHECK( snapshot.hasTriple({ "ex:n999", "rdfs:label", "node 999" }) );
+        CHECK( !snapshot.hasTriple({ "ex:n42", "ex:next", "ex:n41" }) );
+        CHECK( !snapshot.hasTriple({ "ex:n42", "ex:prev", "ex:n41" }) );
+    }
+
+    SECTION( "pattern matching" ) {
+        auto count = [](const Graph &g, const TriplePattern &pattern) {
+            size_t n = 0;
+            Triple t;
+            auto cursor = g.match(pattern);
+            while (cursor->next(t)) {
+                CHECK( pattern.matches(t) );
+                ++n;
+            }
+            return n;
+        };
+
+        CHECK( count(snapshot, { {}, "ex:next", {} }) == 1000 );
+        CHECK( count(snapshot, { "ex:n7", {}, {} }) == 2 );
+        CHECK( count(snapshot, { {}, {}, "ex:n7" }) == 1 );
+        CHECK( count(snapshot, { {}, {}, {} }) == 2000 );
+        CHECK( count(snapshot, { "ex:n7", {}, "ex:n8" }) == 1 );
+        CHECK( count(snapshot, { "ex:unknown", {}, {} }) == 0 );
+    }
+
+    SECTION( "read-only" ) {
+        CHECK_THROWS_AS( snapshot.addTriple({ "a", "b", "c" }), std::logic_error );
+    }
+
+    SECTION( "rejects other files" ) {
+        CHECK_THROWS_AS( SnapshotGraph{"test/sample.ttl"}, std::runtime_error );
+        CHECK_THROWS_AS( SnapshotGraph{"no-such-file"}, std::runtime_error );
+    }
+
+    SECTION( "rejects corrupt files" ) {
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+        SnapshotGraph::Header h;
+        std::memcpy(&h, bytes.data(), sizeof(h));
+
+        // open only checks what it can in constant time, the rest is
+        // left to verify()
+        using Corruption = std::function<void(SnapshotGraph::Header &, char *)>;
+        auto rejects = [&](Corruption corrupt, bool verify = false) {
+            auto copy = bytes;
+            auto header = h;
+            corrupt(header, &copy[0]);
+            std::memcpy(&copy[0], &header, sizeof(header));
+            auto broken = "graphdb-test-broken.snapshot";
+            std::ofstream(broken, std::ios::binary) << copy;
+            bool thrown = false;
+            try {
+                SnapshotGraph snapshot{broken};
+                if (verify) snapshot.verify();
+            } catch (const std::runtime_error &) {
+                thrown = true;
+            }
+            std::remove(broken);
+            return thrown;
+        };
+
+        // sizes that overflow when multiplied
+        CHECK( rejects([](auto &h, char *) { h.terms = uint64_t(1) << 61; }) );
+        CHECK( rejects([](auto &h, char *) { h.slots = uint64_t(1) << 62; }) );
+        CHECK( rejects([](auto &h, char *) { h.triples = ~uint64_t(0) / sizeof(IdTriple) + 2; }) );
+        CHECK( rejects([](auto &h, char *) { h.poolAt = ~uint64_t(0) - 4; }) );
+        // term bounds outside the pool
+        CHECK( rejects([](auto &h, char *data) {
+            uint64_t offset = h.poolSize + 1;
+            std::memcpy(data + h.offsetsAt + 8 * h.terms, &offset, sizeof(offset));
+        }) );
+        CHECK( rejects([](auto &h, char *data) {
+            uint64_t offset = 1;
+            std::memcpy(data + h.offsetsAt, &offset, sizeof(offset));
+        }) );
+
+        // no empty slot, probing would never stop
+        auto full = [](auto &h, char *data) {
+            std::memset(data + h.slotsAt, 0, h.slots * sizeof(TermId));
+        };
+        auto badSlot = [](auto &h, char *data) {
+            TermId id = h.terms;
+            std::memcpy(data + h.slotsAt, &id, sizeof(id));
+        };
+        // term bounds out of order
+        auto descending = [](auto &h, char *data) {
+            uint64_t offset = h.poolSize;
+            std::memcpy(data + h.offsetsAt + 8, &offset, sizeof(offset));
+        };
+        auto badTriple = [](auto &h, char *data) {
+            TermId id = h.terms;
+            std::memcpy(data + h.indexAt[2] + 12 * (h.triples - 1) + 8, &id, sizeof(id));
+        };
+        for (auto &corrupt : std::vector<Corruption>{ full, badSlot, descending, badTriple }) {
+            CHECK( !rejects(corrupt) );
+            CHECK( rejects(corrupt, true) );
+        }
+        CHECK( !rejects([](auto &, char *) {}, true) );
+    }
+
+    std::remove(path);
+}
+
+TEST_CASE( "CSR adjacency", "[csr]" ) {
+    DictionaryGraph graph;
+    graph.addTriple({ "ex:a", "ex:knows", "ex:b" });
+    graph.addTriple({ "ex:a", "ex:likes", "ex:c" });
+    graph.addTriple({ "ex:a", "ex:knows", "ex:c" });
+    graph.addTriple({ "ex:b", "ex:knows", "ex:a" });
+
+    CsrGraph csr(graph);
+    auto &terms = graph.terms();
+    auto a = terms.find("ex:a"), b = terms.find("ex:b"), c = terms.find("ex:c");
+    auto knows = csr.predicateIndex(terms.find("ex:knows"));
+    auto likes = csr.predicateIndex(terms.find("ex:likes"));
+
+    CHECK( csr.termCount() == 5 );
+    CHECK( csr.edgeCount() == 4 );
+    CHECK( csr.predicateCount() == 2 );
+    CHECK( knows != likes );
+    CHECK( csr.predicate(knows) == terms.find("ex:knows") );
+    CHECK( csr.predicateIndex(a) == csr.predicateCount() );
+
+    CHECK( csr.hasNode(a) );
+    CHECK( csr.hasNode(c) );
+    CHECK( !csr.hasNode(terms.find("ex:knows")) );
+
+    auto edges = csr.edges(a);
+    REQUIRE( edges.size() == 3 );
+    CHECK( std::is_sorted(edges.begin(), edges.end(), [](auto &x, auto &y) {
+        return std::tie(x.predicate, x.target) < std::tie(y.predicate, y.target);
+    }) );
+    CHECK( csr.edges(b).size() == 1 );
+    CHECK( csr.edges(b).begin()->target == a );
+    CHECK( csr.edges(c).empty() );
+
+    SECTION( "predicate spans" ) {
+        auto span = csr.edges(a, knows);
+        REQUIRE( span.size() == 2 );
+        CHECK( span.begin()[0].target == b );
+        CHECK( span.begin()[1].target == c );
+        CHECK( csr.edges(a, likes).size() == 1 );
+        CHECK( csr.edges(b, likes).empty() );
+        CHECK( csr.edges(a, csr.predicateCount()).empty() );
+    }
+
+    SECTION( "reverse edges" ) {
+        auto in = csr.reverseEdges(c);
+        REQUIRE( in.size() == 2 );
+        CHECK( csr.reverseEdges(c, knows).size() == 1 );
+        CHECK( csr.reverseEdges(c, knows).begin()->target == a );
+        CHECK( csr.reverseEdges(c, likes).begin()->target == a );
+        CHECK( csr.reverseEdges(a).size() == 1 );
+        CHECK( csr.reverseEdges(a).begin()->target == b );
+    }
+
+    SECTION( "any graph" ) {
+        TripleListGraph list;
+        list.addTriple({ "ex:b", "ex:knows", "ex:a" });
+        list.addTriple({ "ex:a", "ex:knows", "ex:c" });
+        list.addTriple({ "ex:a", "ex:likes", "ex:c" });
+        list.addTriple({ "ex:a", "ex:knows", "ex:b" });
+        list.addTriple({ "ex:a", "ex:knows", "ex:b" });
+
+        TermDictionary dict;
+        CsrGraph other(list, dict);
+        CHECK( other.edgeCount() == 4 );
+        CHECK( other.predicateCount() == 2 );
+        for (auto node : { "ex:a", "ex:b", "ex:c" }) {
+            auto x = csr.edges(terms.find(node));
+            auto y = other.edges(dict.find(node));
+            REQUIRE( x.size() == y.size() );
+            for (size_t i = 0; i < x.size(); ++i) {
+                CHECK( terms.term(x.begin()[i].target) == dict.term(y.begin()[i].target) );
+                CHECK( terms.term(csr.predicate(x.begin()[i].predicate)) ==
+                       dict.term(other.predicate(y.begin()[i].predicate)) );
+            }
+        }
+    }
+}
+
+TEST_CASE( "CSR construction", "[csr]" ) {
+    std::mt19937 rng(GENERATE(take(3, random(0, 1000000))));
+    std::vector<IdTriple> triples;
+    // enough triples to sort on several threads, ids span all four bytes
+    for (int i = 0; i < 300000; ++i) {
+        triples.push_back({ TermId(rng() % 5000), TermId(rng() % 20), TermId(rng() >> (rng() % 32)) });
+    }
+
+    SECTION( "radix sort" ) {
+        auto expected = triples;
+        std::sort(expected.begin(), expected.end(), [](auto &x, auto &y) {
+            return std::tie(x.object, x.predicate, x.subject) < std::tie(y.object, y.predicate, y.subject);
+        });
+        CsrGraph::radixSort(triples, &IdTriple::object, &IdTriple::predicate, &IdTriple::subject, 4);
+        CHECK( triples == expected );
+    }
+
+    SECTION( "delta encoding" ) {
+        for (auto &t : triples) {
+            t.object %= 100000;
+        }
+        CsrGraph::radixSort(triples, &IdTriple::subject, &IdTriple::predicate, &IdTriple::object);
+        triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+        CsrGraph csr(100000, IdRange{ triples.data(), triples.data() + triples.size() });
+        CHECK( csr.edgeCount() == triples.size() );
+
+        for (bool reverse : { false, true }) {
+            PackedAdjacency packed(csr, reverse);
+            // one direction of the CSR takes about half of its memory
+            CHECK( packed.memoryUsage() < csr.memoryUsage() / 3 );
+            for (TermId v = 0; v < csr.termCount(); ++v) {
+                auto edges = reverse ? csr.reverseEdges(v) : csr.edges(v);
+                auto it = edges.begin();
+                bool same = true;
+                packed.forEach(v, [&](uint32_t predicate, TermId target) {
+                    same &= it != edges.end() && it->predicate == predicate && it->target == target;
+                    ++it;
+                });
+                REQUIRE( same );
+                REQUIRE( it == edges.end() );
+            }
+        }
+    }
+}
+
@@ -1,6 +1,16 @@
 #include <catch.hpp>
 #include "graph.hpp"
 #include "rdf.hpp"
+#include "compress.hpp"
+#include "bulk.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
 
 const std::vector<Triple> artists_triples = {
     { "ex:Picasso", "http://www.w3.org/1999/02/22-rdf-syntax-ns#type", "ex:Artist" },
@@ -38,3 +48,255 @@ TEST_CASE( "Painters paint paintings", "[rdf]" ) {
 
     REQUIRE(graph.triples == artists_triples);
 }
+
+TEST_CASE( "Painters paint paintings, dictionary-encoded", "[rdf]" ) {
+    DictionaryGraph graph;
+    RdfReader reader(RdfFormat::Turtle, graph);
+    reader.readUri("test/sample.ttl");
+
+    REQUIRE(graph.size() == artists_triples.size());
+    for (auto &triple : artists_triples) {
+        CHECK(graph.hasTriple(triple));
+    }
+}
+
+TEST_CASE( "Parallel N-Triples loading", "[rdf][ntriples]" ) {
+    TripleListGraph serial;
+    RdfReader(RdfFormat::NTriples, serial).readUri("test/sample.nt");
+    REQUIRE(serial.triples.size() == artists_triples.size());
+
+    unsigned threads = GENERATE(1, 2, 3, 8, 64);
+
+    SECTION( "list graph keeps file order" ) {
+        TripleListGraph graph;
+        RdfReader(RdfFormat::NTriples, graph).readFileParallel("test/sample.nt", threads);
+        REQUIRE(graph.triples == serial.triples);
+    }
+
+    SECTION( "dictionary graph" ) {
+        DictionaryGraph graph;
+        RdfReader(RdfFormat::NTriples, graph).readFileParallel("test/sample.nt", threads);
+        REQUIRE(graph.size() == serial.triples.size());
+        for (auto &triple : serial.triples) {
+            CHECK(graph.hasTriple(triple));
+        }
+    }
+
+    SECTION( "bulk loaded dictionary graph" ) {
+        DictionaryGraph graph;
+        BulkLoadOptions options;
+        // a few triples per sorted run
+        options.memoryBudget = 4 * 2 * sizeof(IdTriple);
+        BulkLoader loader(graph, options);
+        RdfReader(RdfFormat::NTriples, loader).readFileParallel("test/sample.nt", threads);
+        CHECK(loader.spilledRuns() > 0);
+        loader.finish();
+
+        REQUIRE(graph.size() == serial.triples.size());
+        for (auto &triple : serial.triples) {
+            CHECK(graph.hasTriple(triple));
+        }
+    }
+
+    SECTION( "a syntax error throws and leaves the graph unchanged" ) {
+        std::stringstream file;
+        file << std::ifstream("test/sample.nt").rdbuf();
+        std::string text = file.str();
+
+        // a bad line 21, lines are counted across the chunks
+        size_t cut = 0;
+        for (int i = 0; i < 20; ++i) {
+            cut = text.find('\n', cut) + 1;
+        }
+        char path[] = "/tmp/graphdb-test-XXXXXX";
+        int fd = mkstemp(path);
+        REQUIRE(fd >= 0);
+        close(fd);
+        std::ofstream(path, std::ios::binary) << text.substr(0, cut) << "<http://example.org/x> oops .\n" << text.substr(cut);
+
+        TripleListGraph graph;
+        RdfReader reader(RdfFormat::NTriples, graph);
+        CHECK_THROWS_WITH(reader.readFileParallel(path, threads), Catch::Contains("syntax error at 21:"));
+        CHECK(graph.triples.empty());
+        std::remove(path);
+    }
+}
+
+TEST_CASE( "Streaming N-Triples loading", "[rdf][ntriples]" ) {
+    TripleListGraph serial;
+    RdfReader(RdfFormat::NTriples, serial).readUri("test/sample.nt");
+
+    std::stringstream file;
+    file << std::ifstream("test/sample.nt").rdbuf();
+    std::string text = file.str();
+
+    RdfStreamOptions options;
+    options.chunkSize = GENERATE(2, 7, 4096);
+    options.batchSize = 5;
+
+    SECTION( "through a pipe, in batches" ) {
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        // Catch assertions are not thread-safe, the writer only records
+        bool written = true;
+        std::thread writer([&] {
+            // small writes, so the reader sees short reads
+            for (size_t at = 0; at < text.size(); at += 3) {
+                written &= write(fds[1], text.data() + at, std::min<size_t>(3, text.size() - at)) > 0;
+            }
+            close(fds[1]);
+        });
+
+        std::vector<size_t> batches;
+        options.progress = [&](size_t bytes, size_t statements) {
+            CHECK(bytes <= text.size());
+            batches.push_back(statements);
+            return true;
+        };
+
+        TripleListGraph graph;
+        bool completed = RdfReader(RdfFormat::NTriples, graph).readStream(fds[0], options);
+        writer.join();
+        close(fds[0]);
+
+        CHECK(written);
+        CHECK(completed);
+        REQUIRE(graph.triples == serial.triples);
+        REQUIRE(batches.size() == (serial.triples.size() + 4) / 5);
+        for (size_t i = 0; i + 1 < batches.size(); ++i) {
+            CHECK(batches[i] == 5 * (i + 1));
+        }
+    }
+
+    SECTION( "stopped by the progress callback" ) {
+        options.progress = [](size_t, size_t statements) {
+            return statements < 10;
+        };
+
+        size_t at = 0;
+        DictionaryGraph graph;
+        bool completed = RdfReader(RdfFormat::NTriples, graph).readSource([&](char *buf, size_t size) {
+            size_t n = std::min(size, text.size() - at);
+            std::copy_n(text.data() + at, n, buf);
+            at += n;
+            return n;
+        }, options);
+
+        CHECK(!completed);
+        CHECK(graph.size() == 10);
+    }
+
+    SECTION( "a syntax error ends the read" ) {
+        // a bad line after the fifth statement
+        size_t cut = 0;
+        for (int i = 0; i < 5; ++i) {
+            cut = text.find('\n', cut) + 1;
+        }
+        std::string broken = text.substr(0, cut) + "<http://example.org/x> oops .\n" + text.substr(cut);
+
+        size_t at = 0;
+        TripleListGraph graph;
+        RdfReader reader(RdfFormat::NTriples, graph);
+        CHECK_THROWS_WITH(reader.readSource([&](char *buf, size_t size) {
+            size_t n = std::min(size, broken.size() - at);
+            std::copy_n(broken.data() + at, n, buf);
+            at += n;
+            return n;
+        }, options), Catch::Contains("syntax error"));
+
+        // the statements before the error are kept
+        REQUIRE(graph.triples.size() == 5);
+        CHECK(std::equal(graph.triples.begin(), graph.triples.end(), serial.triples.begin()));
+    }
+
+    SECTION( "errors of the progress callback are rethrown" ) {
+        options.progress = [&](size_t, size_t statements) -> bool {
+            if (statements >= 10) throw std::runtime_error("cancelled");
+            return true;
+        };
+
+        size_t at = 0;
+        TripleListGraph graph;
+        RdfReader reader(RdfFormat::NTriples, graph);
+        CHECK_THROWS_WITH(reader.readSource([&](char *buf, size_t size) {
+            size_t n = std::min(size, text.size() - at);
+            std::copy_n(text.data() + at, n, buf);
+            at += n;
+            return n;
+        }, options), "cancelled");
+        CHECK(graph.triples.size() == 10);
+    }
+
+    SECTION( "source errors are rethrown" ) {
+        TripleListGraph graph;
+        RdfReader reader(RdfFormat::NTriples, graph);
+        CHECK_THROWS_AS(reader.readSource([](char *, size_t) -> size_t {
+            throw std::runtime_error("broken source");
+        }, options), std::runtime_error);
+    }
+}
+
+TEST_CASE( "Compressed N-Triples loading", "[rdf][ntriples]" ) {
+    TripleListGraph serial;
+    RdfReader(RdfFormat::NTriples, serial).readUri("test/sample.nt");
+
+    std::stringstream file;
+    file << std::ifstream("test/sample.nt").rdbuf();
+    std::string text = file.str();
+
+    char path[] = "/tmp/graphdb-test-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    close(fd);
+
+    auto gzip = gzopen(path, "wb");
+    REQUIRE(gzip);
+    REQUIRE(gzwrite(gzip, text.data(), text.size()) == int(text.size()));
+    gzclose(gzip);
+
+    SECTION( "gzip" ) {
+        TripleListGraph graph;
+        RdfReader(RdfFormat::NTriples, graph).readFile(path);
+        REQUIRE(graph.triples == serial.triples);
+    }
+
+    SECTION( "tiny buffers wrap around the ring" ) {
+        DecompressingReader input{path, 3, 2};
+        CHECK(input.compression() == Compression::Gzip);
+
+        std::string decoded;
+        char buf[5];
+        while (size_t n = input.read(buf, sizeof buf)) {
+            decoded.append(buf, n);
+        }
+        REQUIRE(decoded == text);
+    }
+
+    SECTION( "uncompressed files pass through" ) {
+        DecompressingReader input{"test/sample.nt"};
+        CHECK(input.compression() == Compression::None);
+
+        TripleListGraph graph;
+        RdfReader(RdfFormat::NTriples, graph).readFile("test/sample.nt");
+        REQUIRE(graph.triples == serial.triples);
+    }
+
+    SECTION( "truncated input" ) {
+        std::stringstream compressed;
+        compressed << std::ifstream(path, std::ios::binary).rdbuf();
+        std::ofstream(path, std::ios::binary) << compressed.str().substr(0, compressed.str().size() / 2);
+
+        TripleListGraph graph;
+        RdfReader reader(RdfFormat::NTriples, graph);
+        CHECK_THROWS_AS(reader.readFile(path), std::runtime_error);
+    }
+
+#ifndef GRAPHDB_ZSTD
+    SECTION( "zstd needs a build with zstd support" ) {
+        std::ofstream(path, std::ios::binary) << "\x28\xb5\x2f\xfd";
+        CHECK_THROWS_AS(DecompressingReader{path}, std::runtime_error);
+    }
+#endif
+
+    std::remove(path);
+}
@@ -0,0 +1,371 @@
+#include <catch.hpp>
+#include "rpq.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+
+namespace {
+
+std::set<std::pair<std::string, std::string>> run(
+        const DictionaryGraph &graph, const std::string &regex, const std::string &start = "",
+        PathEngine engine = PathEngine::Traversal) {
+    CsrGraph csr(graph);
+    PathQuery query(csr, graph.terms().view(), regex, engine);
+    auto pairs = start.empty() ? query.evaluate() : query.evaluate(graph.terms().find(start));
+
+    std::set<std::pair<std::string, std::string>> res;
+    for (auto [s, e] : pairs) {
+        res.emplace(graph.terms().term(s), graph.terms().term(e));
+    }
+    return res;
+}
+
+} // namespace
+
+TEST_CASE( "Boolean matrices", "[matrix]" ) {
+    BitMatrix m(3, 130);
+    CHECK( m.words() == 3 );
+    CHECK( m.count() == 0 );
+
+    m.set(0, 0);
+    m.set(0, 129);
+    m.set(2, 64);
+    CHECK( m.get(0, 129) );
+    CHECK( !m.get(1, 129) );
+    CHECK( m.count() == 3 );
+
+    BitMatrix::orRow(m.row(1), m.row(0), m.words());
+    CHECK( m.get(1, 0) );
+    CHECK( m.get(1, 129) );
+    CHECK( !BitMatrix::andNotRow(m.row(1), m.row(0), m.words()) );
+    m.set(1, 64);
+    CHECK( BitMatrix::andNotRow(m.row(1), m.row(0), m.words()) );
+    CHECK( m.count() == 4 );
+
+    DictionaryGraph graph;
+    graph.addTriple({ "a", "p", "b" });
+    graph.addTriple({ "a", "q", "c" });
+    graph.addTriple({ "b", "p", "c" });
+    CsrGraph csr(graph);
+    auto &terms = graph.terms();
+    auto p = SparseMatrix::forPredicate(csr, csr.predicateIndex(terms.find("p")));
+    CHECK( p.rows() == csr.termCount() );
+    CHECK( p.size() == 2 );
+    REQUIRE( p.end(terms.find("a")) - p.begin(terms.find("a")) == 1 );
+    CHECK( *p.begin(terms.find("a")) == terms.find("b") );
+
+    std::vector<char> used(csr.predicateCount(), 0);
+    used[csr.predicateIndex(terms.find("p"))] = 1;
+    auto all = SparseMatrix::forPredicates(csr, used);
+    REQUIRE( all.size() == csr.predicateCount() );
+    CHECK( all[csr.predicateIndex(terms.find("q"))].size() == 0 );
+    auto &q = all[csr.predicateIndex(terms.find("p"))];
+    REQUIRE( q.rows() == p.rows() );
+    for (TermId v = 0; v < p.rows(); ++v) {
+        CHECK( std::vector<TermId>(q.begin(v), q.end(v)) == std::vector<TermId>(p.begin(v), p.end(v)) );
+    }
+}
+
+TEST_CASE( "Regular path queries", "[rpq]" ) {
+    DictionaryGraph graph;
+    graph.addTriple({ "a", "knows", "b" });
+    graph.addTriple({ "b", "knows", "c" });
+    graph.addTriple({ "c", "knows", "a" });
+    graph.addTriple({ "b", "likes", "d" });
+    graph.addTriple({ "d", "name", "Dora" });
+
+    using Pairs = std::set<std::pair<std::string, std::string>>;
+
+    SECTION( "single predicate" ) {
+        CHECK( run(graph, "<likes>") == Pairs{ { "b", "d" } } );
+        CHECK( run(graph, "<knows>", "c") == Pairs{ { "c", "a" } } );
+    }
+
+    SECTION( "sequences" ) {
+        CHECK( run(graph, "<knows><likes>") == Pairs{ { "a", "d" } } );
+        CHECK( run(graph, "<knows><likes><name>", "a") == Pairs{ { "a", "Dora" } } );
+        CHECK( run(graph, "<likes><knows>").empty() );
+    }
+
+    SECTION( "cycles terminate" ) {
+        CHECK( run(graph, "<knows>*", "a") == Pairs{ { "a", "a" }, { "a", "b" }, { "a", "c" } } );
+        CHECK( run(graph, "<knows><knows>*<likes>") ==
+               Pairs{ { "a", "d" }, { "b", "d" }, { "c", "d" } } );
+    }
+
+    SECTION( "empty word matches every node" ) {
+        auto res = run(graph, "<likes>|");
+        CHECK( res.size() == 6 );
+        CHECK( res.count({ "Dora", "Dora" }) );
+        CHECK( res.count({ "b", "d" }) );
+        CHECK( !res.count({ "knows", "knows" }) );
+    }
+
+    SECTION( "unknown predicates and nodes" ) {
+        CHECK( run(graph, "<hates>").empty() );
+        CHECK( run(graph, "<hates>|<likes>") == Pairs{ { "b", "d" } } );
+        CHECK( run(graph, "<knows>*", "knows").empty() );
+    }
+
+    SECTION( "plain characters name predicates" ) {
+        DictionaryGraph g;
+        g.addTriple({ "x", "p", "y" });
+        g.addTriple({ "y", "q", "z" });
+        CHECK( run(g, "pq") == Pairs{ { "x", "z" } } );
+        CHECK( run(g, "p<q>") == Pairs{ { "x", "z" } } );
+    }
+
+    SECTION( "unterminated names" ) {
+        CHECK_THROWS_AS( run(graph, "<knows"), ParseException );
+    }
+}
+
+TEST_CASE( "Regular path queries against relation algebra", "[rpq]" ) {
+    auto seed = GENERATE(take(30, random(0, 1000000)));
+    std::mt19937 rng(seed);
+
+    // random graph over nodes 0..7 with predicates a, b, c
+    const int n = 8;
+    using Relation = std::set<std::pair<int, int>>;
+    std::map<char, Relation> edges;
+    DictionaryGraph graph;
+    for (int i = 0; i < 16; ++i) {
+        int s = rng() % n, o = rng() % n;
+        char p = "abc"[rng() % 3];
+        edges[p].emplace(s, o);
+        graph.addTriple({ "n" + std::to_string(s), std::string(1, p), "n" + std::to_string(o) });
+    }
+
+    std::set<int> nodes;
+    for (auto &[p, rel] : edges) {
+        for (auto [s, o] : rel) {
+            nodes.insert(s);
+            nodes.insert(o);
+        }
+    }
+
+    // random regex with the relation it denotes on the graph
+    std::function<std::pair<std::string, Relation>(int)> gen = [&](int depth) {
+        std::pair<std::string, Relation> res;
+        switch (depth > 0 ? rng() % 4 : 0) {
+            case 0: {
+                char p = "abc"[rng() % 3];
+                res.first = std::string(1, p);
+                res.second = edges[p];
+                break;
+            }
+            case 1: {
+                auto [x, rx] = gen(depth - 1);
+                auto [y, ry] = gen(depth - 1);
+                res.first = x + y;
+                for (auto [s, m] : rx) {
+                    for (auto [m2, o] : ry) {
+                        if (m == m2) res.second.emplace(s, o);
+                    }
+                }
+                break;
+            }
+            case 2: {
+                auto [x, rx] = gen(depth - 1);
+                auto [y, ry] = gen(depth - 1);
+                res.first = "(" + x + "|" + y + ")";
+                res.second = rx;
+                res.second.insert(ry.begin(), ry.end());
+                break;
+            }
+            default: {
+                auto [x, rx] = gen(depth - 1);
+                res.first = "(" + x + ")*";
+                for (int v : nodes) {
+                    res.second.emplace(v, v);
+                }
+                // transitive closure by repeated composition
+                for (bool changed = true; changed; ) {
+                    changed = false;
+                    auto cur = res.second;
+                    for (auto [s, m] : cur) {
+                        for (auto [m2, o] : rx) {
+                            if (m == m2) changed |= res.second.emplace(s, o).second;
+                        }
+                    }
+                }
+            }
+        }
+        return res;
+    };
+
+    auto [regex, expected] = gen(4);
+
+    std::set<std::pair<std::string, std::string>> names;
+    for (auto [s, o] : expected) {
+        names.emplace("n" + std::to_string(s), "n" + std::to_string(o));
+    }
+
+    INFO( "regex " << regex );
+    CHECK( run(graph, regex) == names );
+    CHECK( run(graph, regex, "", PathEngine::Matrix) == names );
+}
+
+TEST_CASE( "Multi-source path queries", "[rpq]" ) {
+    auto seed = GENERATE(take(10, random(0, 1000000)));
+    std::mt19937 rng(seed);
+
+    // more nodes than fit in a single batch of sources
+    const int n = 300;
+    DictionaryGraph graph;
+    for (int i = 0; i < 600; ++i) {
+        graph.addTriple({
+            "n" + std::to_string(rng() % n),
+            std::string(1, "abc"[rng() % 3]),
+            "n" + std::to_string(rng() % n)
+        });
+    }
+
+    auto regex = GENERATE(as<std::string>{}, "a", "ab*c", "(a|b)*", "a*(bc)*|c", "ab|");
+    INFO( "regex " << regex );
+
+    CsrGraph csr(graph);
+    PathQuery query(csr, graph.terms().view(), regex);
+
+    SECTION( "all sources match single source searches" ) {
+        std::vector<NodePair> expected;
+        for (TermId v = 0; v < csr.termCount(); ++v) {
+            auto pairs = query.evaluate(v);
+            expected.insert(expected.end(), pairs.begin(), pairs.end());
+        }
+        std::sort(expected.begin(), expected.end());
+        CHECK( query.evaluate() == expected );
+    }
+
+    SECTION( "matrix engine matches traversal" ) {
+        PathQuery matrix(csr, graph.terms().view(), regex, PathEngine::Matrix);
+        CHECK( matrix.evaluate() == query.evaluate() );
+        CHECK( matrix.evaluate(TermId(0)) == query.evaluate(TermId(0)) );
+    }
+
+    SECTION( "parallel traversal matches sequential" ) {
+        unsigned threads = GENERATE(1, 2, 4);
+        for (TermId v = 0; v < csr.termCount(); v += 7) {
+            REQUIRE( query.evaluateParallel(v, threads) == query.evaluate(v) );
+        }
+    }
+
+    SECTION( "subsets of sources" ) {
+        std::vector<TermId> starts;
+        std::vector<NodePair> expected;
+        for (int i = 0; i < 100; ++i) {
+            TermId v = rng() % csr.termCount();
+            starts.push_back(v);
+            if (std::find(starts.begin(), starts.end() - 1, v) != starts.end() - 1) continue;
+            auto pairs = query.evaluate(v);
+            expected.insert(expected.end(), pairs.begin(), pairs.end());
+        }
+        std::sort(expected.begin(), expected.end());
+        CHECK( query.evaluate(starts) == expected );
+    }
+}
+
+TEST_CASE( "Parallel traversal on dense graphs", "[rpq]" ) {
+    // frontiers grow fast enough to switch to bottom-up steps
+    std::mt19937 rng(GENERATE(take(5, random(0, 1000000))));
+    const int n = 200;
+    DictionaryGraph graph;
+    for (int i = 0; i < 4000; ++i) {
+        graph.addTriple({
+            "n" + std::to_string(rng() % n),
+            std::string(1, "abc"[rng() % 3]),
+            "n" + std::to_string(rng() % n)
+        });
+    }
+
+    CsrGraph csr(graph);
+    // more than 64 states, the pairs of a node span several words
+    std::string counter = "(";
+    for (int i = 0; i < 70; ++i) {
+        counter += "(a|b|c)";
+    }
+    counter += ")*";
+    auto regex = GENERATE_COPY(as<std::string>{}, "(a|b|c)*", "a(bc)*", "(ab|ba)*c", counter);
+    PathQuery query(csr, graph.terms().view(), regex);
+    unsigned threads = GENERATE(1, 4);
+    INFO( "regex " << regex );
+    for (TermId v = 0; v < csr.termCount(); v += 11) {
+        REQUIRE( query.evaluateParallel(v, threads) == query.evaluate(v) );
+    }
+}
+
+TEST_CASE( "Work stealing", "[parallel]" ) {
+    unsigned threads = GENERATE(1, 3, 8);
+    uint32_t chunks = GENERATE(0, 1, 5, 1000);
+
+    std::vector<std::atomic<int>> seen(chunks);
+    forEachChunk(threads, chunks, [&](unsigned, uint32_t chunk) {
+        ++seen[chunk];
+    });
+    CHECK( std::all_of(seen.begin(), seen.end(), [](auto &x) { return x == 1; }) );
+
+    StealingRange a, b;
+    a.reset(10, 20);
+    CHECK( b.steal(a) );
+    uint32_t chunk;
+    REQUIRE( a.pop(chunk) );
+    CHECK( chunk == 10 );
+    REQUIRE( b.pop(chunk) );
+    CHECK( chunk == 15 );
+    StealingRange empty, c;
+    CHECK( !c.steal(empty) );
+    CHECK( !c.pop(chunk) );
+}
+
+TEST_CASE( "Single producer ring", "[parallel]" ) {
+    SpscRing<int> ring(2);
+    int count = GENERATE(0, 1, 1000);
+
+    SECTION( "slots arrive in order" ) {
+        std::thread producer([&] {
+            for (int i = 0; i < count; ++i) {
+                // long pauses let the consumer fall asleep
+                if (i % 100 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                *ring.back() = i;
+                ring.push();
+            }
+            ring.finish();
+        });
+
+        std::vector<int> got;
+        while (int *slot = ring.front()) {
+            // and the producer as well
+            if (got.size() % 100 == 50) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            got.push_back(*slot);
+            ring.pop();
+        }
+        producer.join();
+
+        REQUIRE( got.size() == size_t(count) );
+        for (int i = 0; i < count; ++i) {
+            CHECK( got[i] == i );
+        }
+    }
+
+    SECTION( "closing wakes a waiting producer" ) {
+        // the producer only records, Catch assertions are not thread-safe
+        int pushed = 0;
+        std::thread producer([&] {
+            while (int *slot = ring.back()) {
+                *slot = pushed++;
+                ring.push();
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ring.close();
+        producer.join();
+        CHECK( pushed == 2 );
+    }
+}